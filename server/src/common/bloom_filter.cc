@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+
+#include "bloom_filter.h"
+#include "db_snapshot.h"
+
+namespace routeguide
+{
+    const uint32_t BloomFilter::kBlockBits;
+    const uint32_t BloomFilter::kDefaultBitsPerKey;
+    const uint32_t BloomFilter::kWordsPerBlock;
+
+    uint64_t BloomFilter::Hash(uint64_t key)
+    {
+        // splitmix64，先加上黄金分割常数，与 PointIndex 的哈希结果区分开
+        key += 0x9e3779b97f4a7c15ULL;
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return key;
+    }
+
+    void BloomFilter::Init(size_t keys, uint32_t bits_per_key)
+    {
+        blocks_ = std::max<size_t>(1, (keys * bits_per_key + kBlockBits - 1) / kBlockBits);
+        // 最优哈希个数约为 bits_per_key * ln2
+        hash_count_ = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(bits_per_key * 0.69)));
+
+        storage_.assign((blocks_ + 1) * kWordsPerBlock, 0);
+        uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+        size_t skip = ((64 - address % 64) % 64) / sizeof(uint64_t);
+        words_ = storage_.data() + skip;
+    }
+
+    void BloomFilter::Add(uint64_t key)
+    {
+        uint64_t hash = Hash(key);
+        // 只能在 Init() 之后添加，此时 words_ 指向 storage_
+        uint64_t *words = storage_.data() + (words_ - storage_.data());
+        // 高 32 位选择块（乘法取代取模），低 32 位按双重哈希生成块内的 k 个比特位置
+        uint64_t *block = words + ((hash >> 32) * blocks_ >> 32) * kWordsPerBlock;
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = (h1 >> 17) | (h1 << 15) | 1;
+        for (uint32_t i = 0; i < hash_count_; i++)
+        {
+            uint32_t bit = (h1 + i * h2) % kBlockBits;
+            block[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+
+    bool BloomFilter::MayContain(uint64_t key) const
+    {
+        if (words_ == nullptr)
+        {
+            return false;
+        }
+        uint64_t hash = Hash(key);
+        const uint64_t *block = words_ + ((hash >> 32) * blocks_ >> 32) * kWordsPerBlock;
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = (h1 >> 17) | (h1 << 15) | 1;
+        for (uint32_t i = 0; i < hash_count_; i++)
+        {
+            uint32_t bit = (h1 + i * h2) % kBlockBits;
+            if ((block[bit / 64] & (1ULL << (bit % 64))) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void BloomFilter::Save(SnapshotWriter *writer) const
+    {
+        uint64_t meta[] = {blocks_, hash_count_};
+        writer->Write(kTagBloomMeta, meta, 2);
+        writer->Write(kTagBloomWords, words_, blocks_ * kWordsPerBlock);
+    }
+
+    bool BloomFilter::Load(SnapshotReader *reader)
+    {
+        const uint64_t *meta = nullptr;
+        size_t meta_count = 0;
+        const uint64_t *words = nullptr;
+        size_t word_count = 0;
+        if (!reader->Read(kTagBloomMeta, &meta, &meta_count) || !reader->Read(kTagBloomWords, &words, &word_count))
+        {
+            return false;
+        }
+        // 块数为 0 时 MayContain 对任何键都返回 false，GetFeature 会全部静默未命中；
+        // 块下标由 32 位哈希乘块数得到，块数也不能超过 2^32
+        if (meta_count != 2 || meta[0] == 0 || meta[0] > UINT32_MAX || meta[1] == 0 || meta[1] > kBlockBits ||
+            word_count != meta[0] * kWordsPerBlock)
+        {
+            return reader->Fail("inconsistent bloom filter");
+        }
+        storage_.clear();
+        storage_.shrink_to_fit();
+        blocks_ = meta[0];
+        hash_count_ = static_cast<uint32_t>(meta[1]);
+        words_ = words;
+        return true;
+    }
+
+} // namespace routeguide
@@ -0,0 +1,81 @@
+/**
+ * @file bloom_filter.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 分块布隆过滤器(blocked Bloom filter)，用于快速判定某个位置上没有 feature
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _BLOOM_FILTER_H_
+#define _BLOOM_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace routeguide
+{
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /**
+     * @brief 分块布隆过滤器。
+     * 位数组划分为 512 位（一个 64 字节缓存行）的块，每个键先哈希到一个块，k 个比特都落在该块内，
+     * 因此一次查询只访问一个缓存行。代价是误判率略高于标准布隆过滤器。
+     * 构建后只读，可以被多个线程同时查询。
+     *
+     */
+    class BloomFilter
+    {
+    public:
+        static const uint32_t kBlockBits = 512;
+        static const uint32_t kDefaultBitsPerKey = 10;
+
+        BloomFilter() : blocks_(0), words_(nullptr), hash_count_(0) {}
+
+        // words_ 指向 storage_ 内部，不能按成员复制
+        BloomFilter(const BloomFilter &) = delete;
+        BloomFilter &operator=(const BloomFilter &) = delete;
+
+        /**
+         * @brief 按预计键个数分配空间并清空，会覆盖之前的内容
+         *
+         * @param keys 预计键个数
+         * @param bits_per_key 每个键占用的比特数，越大误判率越低
+         */
+        void Init(size_t keys, uint32_t bits_per_key = kDefaultBitsPerKey);
+
+        void Add(uint64_t key);
+
+        /**
+         * @brief 判断键是否可能存在
+         *
+         * @return bool false 表示一定不存在，true 表示可能存在
+         */
+        bool MayContain(uint64_t key) const;
+
+        size_t MemoryUsage() const { return blocks_ * kBlockBits / 8; }
+        uint32_t hash_count() const { return hash_count_; }
+
+        /**
+         * @brief 写入快照 / 从快照读取，读出的位数组直接引用快照文件的映射（数据段按 64 字节对齐）
+         *
+         */
+        void Save(SnapshotWriter *writer) const;
+        bool Load(SnapshotReader *reader);
+
+    private:
+        static const uint32_t kWordsPerBlock = kBlockBits / 64;
+
+        static uint64_t Hash(uint64_t key);
+
+        size_t blocks_;
+        std::vector<uint64_t> storage_; // 多分配一个块，从中取出按 64 字节对齐的部分
+        const uint64_t *words_;         // 指向 storage_ 中对齐后的起始位置，或快照文件的映射
+        uint32_t hash_count_;
+    };
+
+} // namespace routeguide
+
+#endif //_BLOOM_FILTER_H_
@@ -0,0 +1,263 @@
+#include <cstdio>
+#include <cstring>
+
+#include "db_snapshot.h"
+
+namespace routeguide
+{
+    namespace
+    {
+        const size_t kSectionAlignment = 64;
+        const uint32_t kByteOrder = 0x01020304;
+        const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+        uint64_t Rotate(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        uint64_t Round(uint64_t acc, uint64_t word)
+        {
+            return Rotate(acc + word * kPrime2, 31) * kPrime1;
+        }
+
+        uint64_t Load64(const unsigned char *p)
+        {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint64_t HeaderChecksum(const SnapshotHeader &header, const SnapshotSection *sections)
+        {
+            SnapshotHeader copy = header;
+            copy.checksum = 0;
+            uint64_t seed = SnapshotChecksum(&copy, sizeof(copy));
+            return SnapshotChecksum(sections, header.section_count * sizeof(SnapshotSection), seed);
+        }
+    } // namespace
+
+    uint64_t SnapshotChecksum(const void *data, size_t size, uint64_t seed)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        const unsigned char *end = p + size;
+
+        // 四个累加器互不依赖，每轮处理 32 字节
+        uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+        for (; end - p >= 32; p += 32)
+        {
+            lanes[0] = Round(lanes[0], Load64(p));
+            lanes[1] = Round(lanes[1], Load64(p + 8));
+            lanes[2] = Round(lanes[2], Load64(p + 16));
+            lanes[3] = Round(lanes[3], Load64(p + 24));
+        }
+
+        uint64_t hash = seed ^ static_cast<uint64_t>(size);
+        for (uint64_t lane : lanes)
+        {
+            hash = Rotate(hash ^ Round(0, lane), 27) * kPrime1 + kPrime2;
+        }
+        for (; end - p >= 8; p += 8)
+        {
+            hash = Rotate(hash ^ Round(0, Load64(p)), 27) * kPrime1 + kPrime2;
+        }
+        for (; p < end; p++)
+        {
+            hash = Rotate(hash ^ (*p * kPrime1), 11) * kPrime2;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime1;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    bool IsSnapshotPath(const std::string &path)
+    {
+        size_t size = sizeof(kSnapshotExtension) - 1;
+        return path.size() > size && path.compare(path.size() - size, size, kSnapshotExtension) == 0;
+    }
+
+    bool SnapshotWriter::Open(const std::string &path)
+    {
+        // 先写到临时文件，完成后再改名：正在运行的服务端可能映射着同名的旧文件，不能原地覆盖
+        path_ = path;
+        file_.open(path_ + ".tmp", std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file_.is_open())
+        {
+            return false;
+        }
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        WriteBytes(&header, sizeof(header)); // 占位，Finish() 时回填
+        return !failed_;
+    }
+
+    void SnapshotWriter::WriteBytes(const void *data, size_t size)
+    {
+        if (size > 0 && !file_.write(static_cast<const char *>(data), static_cast<std::streamsize>(size)))
+        {
+            failed_ = true;
+        }
+        offset_ += size;
+    }
+
+    void SnapshotWriter::Pad()
+    {
+        static const char kZeros[kSectionAlignment] = {0};
+        WriteBytes(kZeros, (kSectionAlignment - offset_ % kSectionAlignment) % kSectionAlignment);
+    }
+
+    void SnapshotWriter::WriteSection(SnapshotTag tag, const void *data, size_t element_size, size_t count)
+    {
+        Pad();
+        SnapshotSection section;
+        section.offset = offset_;
+        section.count = count;
+        section.tag = tag;
+        section.element_size = static_cast<uint32_t>(element_size);
+        section.checksum = SnapshotChecksum(data, element_size * count);
+        sections_.push_back(section);
+        WriteBytes(data, element_size * count);
+    }
+
+    bool SnapshotWriter::Finish()
+    {
+        Pad();
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.byte_order = kByteOrder;
+        header.directory_offset = offset_;
+        header.section_count = sections_.size();
+        WriteBytes(sections_.data(), sections_.size() * sizeof(SnapshotSection));
+        header.file_size = offset_;
+        header.checksum = HeaderChecksum(header, sections_.data());
+
+        file_.seekp(0);
+        file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file_.close();
+        if (failed_ || file_.fail())
+        {
+            std::remove((path_ + ".tmp").c_str());
+            return false;
+        }
+        return std::rename((path_ + ".tmp").c_str(), path_.c_str()) == 0;
+    }
+
+    bool SnapshotReader::Fail(const char *error)
+    {
+        if (error_ == nullptr)
+        {
+            error_ = error;
+        }
+        return false;
+    }
+
+    bool SnapshotReader::Open(const std::string &path)
+    {
+        file_.reset(new MappedFile());
+        if (!file_->Open(path, MappedFile::kNormal))
+        {
+            return Fail("cannot map file");
+        }
+        size_t size = file_->size();
+        if (size < sizeof(SnapshotHeader))
+        {
+            return Fail("file too small");
+        }
+
+        const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(file_->data());
+        if (std::memcmp(header->magic, kSnapshotMagic, sizeof(header->magic)) != 0)
+        {
+            return Fail("not a snapshot file");
+        }
+        if (header->version != kSnapshotVersion)
+        {
+            return Fail("unsupported snapshot version");
+        }
+        if (header->byte_order != kByteOrder)
+        {
+            return Fail("byte order mismatch");
+        }
+        if (header->file_size != size)
+        {
+            return Fail("file size mismatch");
+        }
+        if (header->directory_offset < sizeof(SnapshotHeader) || header->directory_offset > size ||
+            header->directory_offset % kSectionAlignment != 0 ||
+            header->section_count != (size - header->directory_offset) / sizeof(SnapshotSection))
+        {
+            return Fail("bad section directory");
+        }
+        const SnapshotSection *sections =
+            reinterpret_cast<const SnapshotSection *>(file_->data() + header->directory_offset);
+        if (HeaderChecksum(*header, sections) != header->checksum)
+        {
+            return Fail("header checksum mismatch");
+        }
+        for (size_t i = 0; i < header->section_count; i++)
+        {
+            const SnapshotSection &section = sections[i];
+            if (section.element_size == 0 || section.offset % kSectionAlignment != 0 ||
+                section.offset < sizeof(SnapshotHeader) || section.offset > header->directory_offset ||
+                section.count > (header->directory_offset - section.offset) / section.element_size)
+            {
+                return Fail("section out of range");
+            }
+        }
+
+        header_ = header;
+        sections_ = sections;
+        next_ = 0;
+        return true;
+    }
+
+    bool SnapshotReader::Verify()
+    {
+        if (header_ == nullptr)
+        {
+            return Fail("snapshot not open");
+        }
+        for (size_t i = 0; i < header_->section_count; i++)
+        {
+            const SnapshotSection &section = sections_[i];
+            if (SnapshotChecksum(file_->data() + section.offset, section.count * section.element_size) !=
+                section.checksum)
+            {
+                return Fail("section checksum mismatch");
+            }
+        }
+        return true;
+    }
+
+    bool SnapshotReader::ReadSection(SnapshotTag tag, size_t element_size, const void **data, size_t *count)
+    {
+        if (error_ != nullptr)
+        {
+            return false;
+        }
+        if (next_ >= sections_count())
+        {
+            return Fail("missing section");
+        }
+        const SnapshotSection &section = sections_[next_];
+        if (section.tag != tag)
+        {
+            return Fail("unexpected section");
+        }
+        if (section.element_size != element_size)
+        {
+            return Fail("element size mismatch");
+        }
+        *data = file_->data() + section.offset;
+        *count = section.count;
+        next_++;
+        return true;
+    }
+
+} // namespace routeguide
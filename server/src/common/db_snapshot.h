@@ -0,0 +1,224 @@
+/**
+ * @file db_snapshot.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 二进制数据库快照(.rgsnap)的读写：feature 数据和全部索引按数组原样存放，加载时映射文件直接使用
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _DB_SNAPSHOT_H_
+#define _DB_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "flat_array.h"
+#include "mapped_file.h"
+
+namespace routeguide
+{
+    /**
+     * 文件布局（全部按本机字节序，只能在相同架构的机器之间使用）：
+     *   SnapshotHeader   64 字节，位于文件开头
+     *   数据段 ...       每段按 64 字节对齐，内容为某个数组的全部元素
+     *   SnapshotSection  数据段目录，按写入顺序排列
+     * 头部校验和覆盖头部和目录，打开文件时检查；每个数据段有自己的校验和，由 Verify() 检查。
+     * 数据段的顺序由各个类的 Save()/Load() 决定，读取时逐段核对类型标签和元素大小。
+     */
+    const char kSnapshotMagic[8] = {'R', 'G', 'S', 'N', 'A', 'P', '\r', '\n'};
+    const uint32_t kSnapshotVersion = 2; // 2: 名称索引的倒排表偏移改为 64 位
+    const char kSnapshotExtension[] = ".rgsnap";
+
+    /**
+     * @brief 数据段类型标签，只用于读取时核对顺序，不参与定位
+     *
+     */
+    enum SnapshotTag : uint32_t
+    {
+        kTagDbMeta = 1,
+        kTagLatitude,
+        kTagLongitude,
+        kTagNameOffset,
+        kTagNames,
+        kTagGeohashKeys,
+        kTagPointMeta,
+        kTagPointSlots,
+        kTagBloomMeta,
+        kTagBloomWords,
+        kTagSpatialLatitude,
+        kTagSpatialLongitude,
+        kTagSpatialIds,
+        kTagSpatialNodes,
+        kTagSpatialLevels,
+        kTagPartitions,
+        kTagUnitVectors,
+        kTagFoldedNames,
+        kTagFoldedOffset,
+        kTagNameSorted,
+        kTagGramKeys,
+        kTagGramOffset,
+        kTagPostings,
+        kTagWireOffset,
+        kTagWire,
+    };
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order; // 写入 0x01020304，用于识别字节序不同的文件
+        uint64_t file_size;
+        uint64_t directory_offset;
+        uint64_t section_count;
+        uint64_t reserved[2];
+        uint64_t checksum; // 计算时本字段为 0，覆盖头部和目录
+    };
+
+    struct SnapshotSection
+    {
+        uint64_t offset;
+        uint64_t count;
+        uint32_t tag;
+        uint32_t element_size;
+        uint64_t checksum;
+    };
+
+    /**
+     * @brief 快照使用的 64 位校验和，四路并行累加，速度接近内存带宽
+     *
+     */
+    uint64_t SnapshotChecksum(const void *data, size_t size, uint64_t seed = 0);
+
+    /**
+     * @brief 判断文件名是否为快照文件（按扩展名）
+     *
+     */
+    bool IsSnapshotPath(const std::string &path);
+
+    /**
+     * @brief 顺序写入快照文件：先写数据段，Finish() 时写目录并回填头部。
+     * 内容先写到 path.tmp，成功后再改名为 path，不影响正在映射旧文件的进程
+     *
+     */
+    class SnapshotWriter
+    {
+    public:
+        SnapshotWriter() : offset_(0), failed_(false) {}
+
+        bool Open(const std::string &path);
+
+        template <typename T>
+        void Write(SnapshotTag tag, const T *data, size_t count)
+        {
+            WriteSection(tag, data, sizeof(T), count);
+        }
+
+        template <typename T>
+        void Write(SnapshotTag tag, const FlatArray<T> &array)
+        {
+            WriteSection(tag, array.data(), sizeof(T), array.size());
+        }
+
+        /**
+         * @brief 写入目录和头部并关闭文件
+         *
+         * @return bool 全部写入是否成功
+         */
+        bool Finish();
+
+    private:
+        void WriteSection(SnapshotTag tag, const void *data, size_t element_size, size_t count);
+        void WriteBytes(const void *data, size_t size);
+        void Pad(); // 补零到数据段对齐的位置
+
+        std::string path_;
+        std::ofstream file_;
+        uint64_t offset_;
+        bool failed_;
+        std::vector<SnapshotSection> sections_;
+    };
+
+    /**
+     * @brief 映射快照文件并按写入顺序逐段读取，读出的数组直接引用映射的内存。
+     * 任何一步失败后 error() 返回原因，之后的读取全部失败
+     *
+     */
+    class SnapshotReader
+    {
+    public:
+        SnapshotReader() : header_(nullptr), sections_(nullptr), next_(0), error_(nullptr) {}
+
+        /**
+         * @brief 映射文件并检查头部和目录：魔数、版本、字节序、头部校验和，以及每个数据段都在文件范围内。
+         * 只读取头部和目录，耗时与数据量无关
+         *
+         */
+        bool Open(const std::string &path);
+
+        /**
+         * @brief 检查所有数据段的校验和，需要读取整个文件
+         *
+         */
+        bool Verify();
+
+        template <typename T>
+        bool Read(SnapshotTag tag, const T **data, size_t *count)
+        {
+            const void *section = nullptr;
+            if (!ReadSection(tag, sizeof(T), &section, count))
+            {
+                return false;
+            }
+            *data = static_cast<const T *>(section);
+            return true;
+        }
+
+        template <typename T>
+        bool Read(SnapshotTag tag, FlatArray<T> *array)
+        {
+            const T *data = nullptr;
+            size_t count = 0;
+            if (!Read(tag, &data, &count))
+            {
+                return false;
+            }
+            array->Borrow(data, count);
+            return true;
+        }
+
+        /**
+         * @brief 记录一个错误，用于调用方发现数据段之间不一致的情况
+         *
+         * @return bool 总是返回 false
+         */
+        bool Fail(const char *error);
+
+        bool done() const { return error_ == nullptr && next_ == sections_count(); }
+        const char *error() const { return error_ != nullptr ? error_ : "ok"; }
+        size_t file_size() const { return file_ ? file_->size() : 0; }
+
+        /**
+         * @brief 交出映射，读出的数组在映射释放前一直有效
+         *
+         */
+        std::unique_ptr<MappedFile> ReleaseFile() { return std::move(file_); }
+
+    private:
+        bool ReadSection(SnapshotTag tag, size_t element_size, const void **data, size_t *count);
+        size_t sections_count() const { return header_ != nullptr ? header_->section_count : 0; }
+
+        std::unique_ptr<MappedFile> file_;
+        const SnapshotHeader *header_;
+        const SnapshotSection *sections_;
+        size_t next_;
+        const char *error_;
+    };
+
+} // namespace routeguide
+
+#endif //_DB_SNAPSHOT_H_
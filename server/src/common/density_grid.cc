@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+#include "density_grid.h"
+
+namespace routeguide
+{
+    namespace
+    {
+        // 每个任务至少分到的点数，点数太少时任务调度和局部计数数组的开销超过并行带来的收益
+        const size_t kMinRowsPerTask = 1 << 16;
+        const size_t kTasksPerThread = 4;
+
+        void CountRange(const int32_t *lat, const int32_t *lon, size_t begin, size_t end,
+                        const GridLayout &layout, uint32_t *counts)
+        {
+            const BoundingBox &box = layout.box;
+            for (size_t i = begin; i < end; i++)
+            {
+                if (box.Contains(lat[i], lon[i]))
+                {
+                    counts[layout.Cell(lat[i], lon[i])]++;
+                }
+            }
+        }
+    } // namespace
+
+    void CountDensity(const int32_t *lat, const int32_t *lon, const std::vector<std::pair<size_t, size_t>> &ranges,
+                      const GridLayout &layout, ThreadPool *pool, std::vector<uint32_t> *counts)
+    {
+        counts->assign(layout.cells(), 0);
+        size_t total = 0;
+        for (const std::pair<size_t, size_t> &range : ranges)
+        {
+            total += range.second - range.first;
+        }
+        if (pool == nullptr || pool->size() <= 1 || total < 2 * kMinRowsPerTask)
+        {
+            for (const std::pair<size_t, size_t> &range : ranges)
+            {
+                CountRange(lat, lon, range.first, range.second, layout, counts->data());
+            }
+            return;
+        }
+
+        // 每段至少 kMinRowsPerTask 个点，段数约为线程数的几倍，使各线程的负载大致均衡
+        size_t chunk = std::max(kMinRowsPerTask, total / (pool->size() * kTasksPerThread));
+        std::mutex mu;
+        std::condition_variable cv;
+        size_t pending = 0;
+        for (const std::pair<size_t, size_t> &range : ranges)
+        {
+            for (size_t begin = range.first; begin < range.second; begin += chunk)
+            {
+                size_t end = std::min(range.second, begin + chunk);
+                {
+                    std::unique_lock<std::mutex> lock(mu);
+                    pending++;
+                }
+                pool->Submit([lat, lon, begin, end, &layout, &mu, &cv, &pending, counts]() {
+                    std::vector<uint32_t> local(layout.cells(), 0);
+                    CountRange(lat, lon, begin, end, layout, local.data());
+
+                    // 持有锁时通知，调用线程看到 pending 为 0 返回后，本任务不会再访问栈上的变量
+                    std::unique_lock<std::mutex> lock(mu);
+                    for (size_t cell = 0; cell < local.size(); cell++)
+                    {
+                        (*counts)[cell] += local[cell];
+                    }
+                    if (--pending == 0)
+                    {
+                        cv.notify_one();
+                    }
+                });
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&pending]() { return pending == 0; });
+    }
+
+} // namespace routeguide
@@ -0,0 +1,67 @@
+/**
+ * @file density_grid.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 密度网格统计：把矩形划分为 cols x rows 个格子，在线程池中并行扫描经纬度列统计每个格子内的点数
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _DENSITY_GRID_H_
+#define _DENSITY_GRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "spatial_index.h"
+#include "thread_pool.h"
+
+namespace routeguide
+{
+    /**
+     * @brief 网格划分方式。格子按行优先存放，第 0 行在矩形最北端，第 0 列在最西端
+     *
+     */
+    struct GridLayout
+    {
+        BoundingBox box;
+        uint32_t cols;
+        uint32_t rows;
+
+        size_t cells() const { return static_cast<size_t>(cols) * rows; }
+
+        /**
+         * @brief 计算点所在格子的下标，调用方保证点落在 box 内
+         *
+         */
+        size_t Cell(int32_t lat, int32_t lon) const
+        {
+            int64_t width = static_cast<int64_t>(box.max_lon) - box.min_lon + 1;
+            int64_t height = static_cast<int64_t>(box.max_lat) - box.min_lat + 1;
+            size_t col = static_cast<size_t>((static_cast<int64_t>(lon) - box.min_lon) * cols / width);
+            size_t row = static_cast<size_t>((static_cast<int64_t>(box.max_lat) - lat) * rows / height);
+            return row * cols + col;
+        }
+    };
+
+    /**
+     * @brief 统计若干行号区间内落在 layout.box 内的点在每个格子中的个数。
+     * 调用方只传入可能与 box 相交的区间（例如与 box 相交的分区），其余的行不会被扫描。
+     * 较长的区间按行号切分，点数较多时各段作为任务提交到 pool 并行执行，每个任务写自己的局部计数数组，
+     * 完成后在锁内累加到结果中，任务之间无共享写入
+     *
+     * @param lat 纬度列
+     * @param lon 经度列
+     * @param ranges 行号区间 [first, second)
+     * @param layout 网格划分方式
+     * @param pool 执行任务的线程池，为空时在调用线程中顺序执行
+     * @param counts 输出计数，大小为 layout.cells()，会覆盖之前的内容
+     */
+    void CountDensity(const int32_t *lat, const int32_t *lon, const std::vector<std::pair<size_t, size_t>> &ranges,
+                      const GridLayout &layout, ThreadPool *pool, std::vector<uint32_t> *counts);
+
+} // namespace routeguide
+
+#endif //_DENSITY_GRID_H_
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <random>
+
+#include "feature_db.h"
+#include "db_snapshot.h"
+#include "helper.h"
+#include "userlog.h"
+
+#include "route_guide.grpc.pb.h"
+
+namespace routeguide
+{
+    namespace
+    {
+        // 快照中 FeatureDb 自身的标量字段
+        struct SnapshotDbMeta
+        {
+            uint64_t rows;
+            uint64_t partitions;
+            double bloom_false_positive_rate;
+            uint64_t reserved;
+        };
+
+        // 快照中每个分区的行号区间和包围盒，分区的 R 树紧随其后依次存放
+        struct SnapshotPartition
+        {
+            uint64_t begin;
+            uint64_t end;
+            BoundingBox bounds;
+        };
+    } // namespace
+
+    const size_t FeatureDb::kMinPartitionRows;
+    const size_t FeatureDb::kMaxPartitions;
+
+    FeatureDb::FeatureDb(uint64_t version) : version_(version), bloom_false_positive_rate_(0)
+    {
+    }
+
+    FeatureDb::FeatureDb(FeatureStore &&store, uint64_t version)
+        : version_(version), store_(std::move(store)), bloom_false_positive_rate_(0)
+    {
+        store_.ShrinkToFit();
+        SortByGeohash();
+        BuildIndexes();
+        EncodeFeatures();
+    }
+
+    std::shared_ptr<const FeatureDb> FeatureDb::OpenSnapshot(const std::string &path, uint64_t version)
+    {
+        SnapshotReader reader;
+        std::shared_ptr<FeatureDb> db(new FeatureDb(version));
+        if (!reader.Open(path) || !db->LoadSnapshot(&reader))
+        {
+            SPDLOG_ERROR("Failed to open snapshot {}: {}", path, reader.error());
+            return nullptr;
+        }
+        db->snapshot_file_ = reader.ReleaseFile();
+        SPDLOG_INFO("Snapshot {} mapped, {:d} features, {:d} bytes.", path, db->store_.size(),
+                    db->snapshot_file_->size());
+        return db;
+    }
+
+    bool FeatureDb::LoadSnapshot(SnapshotReader *reader)
+    {
+        const SnapshotDbMeta *meta = nullptr;
+        size_t count = 0;
+        if (!reader->Read(kTagDbMeta, &meta, &count))
+        {
+            return false;
+        }
+        if (count != 1)
+        {
+            return reader->Fail("bad database header");
+        }
+        size_t rows = meta->rows;
+        bloom_false_positive_rate_ = meta->bloom_false_positive_rate;
+
+        if (!store_.Load(reader) || !reader->Read(kTagGeohashKeys, &geohash_keys_) ||
+            !point_index_.Load(reader, rows) || !bloom_filter_.Load(reader) || !spatial_index_.Load(reader))
+        {
+            return false;
+        }
+        if (store_.size() != rows || geohash_keys_.size() != rows || spatial_index_.size() != rows)
+        {
+            return reader->Fail("inconsistent row count");
+        }
+
+        const SnapshotPartition *partitions = nullptr;
+        if (!reader->Read(kTagPartitions, &partitions, &count))
+        {
+            return false;
+        }
+        if (count != meta->partitions || count == 0)
+        {
+            return reader->Fail("bad partition table");
+        }
+        partitions_.resize(count);
+        size_t next = 0;
+        for (size_t p = 0; p < count; p++)
+        {
+            FeaturePartition &partition = partitions_[p];
+            partition.begin = partitions[p].begin;
+            partition.end = partitions[p].end;
+            partition.bounds = partitions[p].bounds;
+            if (!partition.index.Load(reader))
+            {
+                return false;
+            }
+            if (partition.begin != next || partition.end < partition.begin || partition.end > rows ||
+                partition.index.size() != partition.end - partition.begin)
+            {
+                return reader->Fail("bad partition table");
+            }
+            next = partition.end;
+        }
+        if (next != rows)
+        {
+            return reader->Fail("bad partition table");
+        }
+
+        if (!reader->Read(kTagUnitVectors, &unit_vectors_) || !name_index_.Load(reader, rows) ||
+            !reader->Read(kTagWireOffset, &wire_offset_) || !reader->Read(kTagWire, &wire_))
+        {
+            return false;
+        }
+        if (unit_vectors_.size() != rows || wire_offset_.size() != rows + 1 || wire_offset_.back() != wire_.size())
+        {
+            return reader->Fail("inconsistent row count");
+        }
+        if (wire_offset_[0] != 0 || !std::is_sorted(wire_offset_.begin(), wire_offset_.end()))
+        {
+            return reader->Fail("bad wire offsets");
+        }
+        return reader->done() || reader->Fail("unexpected trailing sections");
+    }
+
+    bool FeatureDb::SaveSnapshot(const std::string &path) const
+    {
+        SnapshotWriter writer;
+        if (!writer.Open(path))
+        {
+            return false;
+        }
+
+        SnapshotDbMeta meta = {store_.size(), partitions_.size(), bloom_false_positive_rate_, 0};
+        writer.Write(kTagDbMeta, &meta, 1);
+        store_.Save(&writer);
+        writer.Write(kTagGeohashKeys, geohash_keys_);
+        point_index_.Save(&writer);
+        bloom_filter_.Save(&writer);
+        spatial_index_.Save(&writer);
+
+        std::vector<SnapshotPartition> partitions;
+        for (const FeaturePartition &partition : partitions_)
+        {
+            SnapshotPartition entry = {partition.begin, partition.end, partition.bounds};
+            partitions.push_back(entry);
+        }
+        writer.Write(kTagPartitions, partitions.data(), partitions.size());
+        for (const FeaturePartition &partition : partitions_)
+        {
+            partition.index.Save(&writer);
+        }
+
+        writer.Write(kTagUnitVectors, unit_vectors_);
+        name_index_.Save(&writer);
+        writer.Write(kTagWireOffset, wire_offset_);
+        writer.Write(kTagWire, wire_);
+        return writer.Finish();
+    }
+
+    void FeatureDb::FindGeohashRange(uint64_t lo, uint64_t hi, size_t *begin, size_t *end) const
+    {
+        *begin = std::lower_bound(geohash_keys_.begin(), geohash_keys_.end(), lo) - geohash_keys_.begin();
+        *end = std::lower_bound(geohash_keys_.begin() + *begin, geohash_keys_.end(), hi) - geohash_keys_.begin();
+    }
+
+    void FeatureDb::SortByGeohash()
+    {
+        size_t n = store_.size();
+        std::vector<std::pair<uint64_t, uint32_t>> keyed(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            keyed[i] = std::make_pair(GetGeohashKey(store_.latitude(i), store_.longitude(i)), static_cast<uint32_t>(i));
+        }
+        std::sort(keyed.begin(), keyed.end());
+
+        std::vector<uint32_t> order(n);
+        geohash_keys_.resize(n);
+        uint64_t *keys = geohash_keys_.mutable_data();
+        for (size_t i = 0; i < n; i++)
+        {
+            keys[i] = keyed[i].first;
+            order[i] = keyed[i].second;
+        }
+        store_.Permute(order);
+        SPDLOG_INFO("Features sorted by geohash.");
+    }
+
+    void FeatureDb::BuildIndexes()
+    {
+        const int32_t *lat = store_.latitudes();
+        const int32_t *lon = store_.longitudes();
+        point_index_.Reserve(store_.size());
+        for (size_t i = 0; i < store_.size(); i++)
+        {
+            point_index_.Insert(PackPoint(lat[i], lon[i]), static_cast<uint32_t>(i));
+        }
+        SPDLOG_INFO("Point index built, {:d} distinct locations.", point_index_.size());
+
+        bloom_filter_.Init(point_index_.size());
+        for (size_t i = 0; i < store_.size(); i++)
+        {
+            bloom_filter_.Add(PackPoint(lat[i], lon[i]));
+        }
+        // 用随机键实测误判率，随机键几乎不可能恰好是已有位置，仍用 point_index_ 排除
+        const size_t kProbes = 100000;
+        std::mt19937_64 generator(20200805);
+        size_t negatives = 0;
+        size_t false_positives = 0;
+        for (size_t i = 0; i < kProbes; i++)
+        {
+            uint64_t key = generator();
+            if (point_index_.Find(key) == PointIndex::kNotFound)
+            {
+                negatives++;
+                false_positives += bloom_filter_.MayContain(key) ? 1 : 0;
+            }
+        }
+        bloom_false_positive_rate_ = negatives > 0 ? static_cast<double>(false_positives) / negatives : 0;
+        SPDLOG_INFO("Bloom filter built, {:d} bytes, {:d} hashes, false positive rate {:.4f}.",
+                    bloom_filter_.MemoryUsage(), bloom_filter_.hash_count(), bloom_false_positive_rate_);
+
+        spatial_index_.Build(lat, lon, store_.size());
+        SPDLOG_INFO("Spatial index built, {:d} entries.", spatial_index_.size());
+
+        // 行已按 geohash 排序，等分行号即得到空间上紧凑的分区
+        size_t n = store_.size();
+        size_t partitions = std::max<size_t>(1, std::min(n / kMinPartitionRows, kMaxPartitions));
+        partitions_.clear();
+        partitions_.resize(partitions);
+        for (size_t p = 0; p < partitions; p++)
+        {
+            FeaturePartition &partition = partitions_[p];
+            partition.begin = n * p / partitions;
+            partition.end = n * (p + 1) / partitions;
+            BoundingBox empty = {INT32_MAX, INT32_MIN, INT32_MAX, INT32_MIN};
+            partition.bounds = empty;
+            for (size_t row = partition.begin; row < partition.end; row++)
+            {
+                partition.bounds.min_lat = std::min(partition.bounds.min_lat, lat[row]);
+                partition.bounds.max_lat = std::max(partition.bounds.max_lat, lat[row]);
+                partition.bounds.min_lon = std::min(partition.bounds.min_lon, lon[row]);
+                partition.bounds.max_lon = std::max(partition.bounds.max_lon, lon[row]);
+            }
+            partition.index.Build(lat + partition.begin, lon + partition.begin, partition.end - partition.begin);
+        }
+        SPDLOG_INFO("Spatial partitions built, {:d} partitions.", partitions_.size());
+
+        unit_vectors_.resize(store_.size());
+        UnitVector *unit_vectors = unit_vectors_.mutable_data();
+        for (size_t i = 0; i < store_.size(); i++)
+        {
+            unit_vectors[i] = ToUnitVector(lat[i], lon[i]);
+        }
+
+        name_index_.Build(store_);
+        SPDLOG_INFO("Name index built, {:d} bytes.", name_index_.MemoryUsage());
+    }
+
+    void FeatureDb::EncodeFeatures()
+    {
+        wire_offset_.assign(1, 0);
+        wire_offset_.reserve(store_.size() + 1);
+        wire_.clear();
+        // 每个 feature 的编码为 名称 + 两个 varint 坐标 + 若干字节的标签和长度
+        wire_.reserve(store_.name_bytes() + store_.size() * 24);
+
+        Feature feature;
+        for (size_t i = 0; i < store_.size(); i++)
+        {
+            store_.ToFeature(i, &feature);
+            size_t offset = wire_.size();
+            wire_.resize(offset + feature.ByteSizeLong());
+            feature.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(wire_.mutable_data() + offset));
+            wire_offset_.push_back(wire_.size());
+        }
+        wire_.shrink_to_fit();
+        SPDLOG_INFO("Features encoded, {:d} bytes.", wire_.size());
+    }
+
+    std::shared_ptr<const FeatureDb> LoadFeatureDb(const std::string &db_path, uint64_t version, size_t load_threads)
+    {
+        if (DetectDbFormat(db_path) == kDbSnapshot)
+        {
+            return FeatureDb::OpenSnapshot(db_path, version);
+        }
+        FeatureStore store;
+        if (!LoadDbFile(db_path, &store, load_threads))
+        {
+            return nullptr;
+        }
+        return std::make_shared<const FeatureDb>(std::move(store), version);
+    }
+
+} // namespace routeguide
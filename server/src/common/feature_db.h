@@ -0,0 +1,179 @@
+/**
+ * @file feature_db.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief feature 数据库快照：一次加载的 feature 数据及其全部索引
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _FEATURE_DB_H_
+#define _FEATURE_DB_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "feature_store.h"
+#include "flat_array.h"
+#include "geo_util.h"
+#include "mapped_file.h"
+#include "name_index.h"
+#include "point_index.h"
+#include "spatial_index.h"
+
+namespace routeguide
+{
+    class SnapshotReader;
+
+    /**
+     * @brief 主库的一个空间分区：按 geohash 排序后连续的一段行及其 R 树，大范围查询时各分区可以并行查询
+     *
+     */
+    struct FeaturePartition
+    {
+        size_t begin;       // 行号区间 [begin, end)
+        size_t end;
+        BoundingBox bounds; // 分区内所有位置的包围盒
+        SpatialIndex index; // 条目为分区内的相对行号 row - begin
+    };
+
+    /**
+     * @brief 只读的 feature 数据库快照。
+     * 构造完成后不再修改，可以被多个请求线程同时读取；热加载时整体构造一个新快照再替换。
+     * 构造时所有 feature 按 geohash 键排序，空间上相邻的 feature 在内存中也相邻，
+     * 矩形范围扫描读取的坐标和编码数据更集中，geohash 前缀查询只需二分查找出一段连续的行。
+     * 也可以从二进制快照文件打开：所有数组直接引用映射的文件，不解析、不构建索引，
+     * 打开时只顺序检查各索引中的行号、偏移和节点范围不越界，保证损坏的文件不会让查询越界或死循环。
+     *
+     */
+    class FeatureDb
+    {
+    public:
+        // 每个分区至少包含的行数，以及最多的分区数
+        static const size_t kMinPartitionRows = 1 << 15;
+        static const size_t kMaxPartitions = 64;
+
+        /**
+         * @brief 使用已经准备好的 feature 数据构建索引，用于加载数据库和增量层合并
+         *
+         * @param store feature 数据，内容会被移走
+         * @param version 快照版本号，每次重新加载或合并增量层时递增
+         */
+        FeatureDb(FeatureStore &&store, uint64_t version);
+
+        FeatureDb(const FeatureDb &) = delete;
+        FeatureDb &operator=(const FeatureDb &) = delete;
+
+        /**
+         * @brief 打开二进制快照文件(.rgsnap)，不重新解析和构建索引，但会顺序扫描以下数据段检查内容：
+         * 名称和编码数据的偏移、点索引的槽位、R 树的条目行号和节点范围、名称索引的偏移和行号，
+         * 耗时与数据量成正比（不计算数据段校验和，校验和由 SnapshotReader::Verify 检查）。
+         * 快照文件在返回的对象销毁前保持映射
+         *
+         * @param path 快照文件路径
+         * @param version 快照版本号
+         * @return std::shared_ptr<const FeatureDb> 文件无效时返回空指针
+         */
+        static std::shared_ptr<const FeatureDb> OpenSnapshot(const std::string &path, uint64_t version);
+
+        /**
+         * @brief 把 feature 数据和全部索引写入二进制快照文件
+         *
+         * @return bool 是否写入成功
+         */
+        bool SaveSnapshot(const std::string &path) const;
+
+        uint64_t version() const { return version_; }
+        const FeatureStore &store() const { return store_; }
+        const PointIndex &point_index() const { return point_index_; }
+        const BloomFilter &bloom_filter() const { return bloom_filter_; }
+
+        /**
+         * @brief 布隆过滤器的误判率，构建时用随机位置实测得到
+         *
+         */
+        double bloom_false_positive_rate() const { return bloom_false_positive_rate_; }
+        const SpatialIndex &spatial_index() const { return spatial_index_; }
+        const FlatArray<UnitVector> &unit_vectors() const { return unit_vectors_; }
+        const NameIndex &name_index() const { return name_index_; }
+
+        /**
+         * @brief 空间分区，按行号顺序排列并覆盖全部行
+         *
+         */
+        const std::vector<FeaturePartition> &partitions() const { return partitions_; }
+
+        /**
+         * @brief 第 row 行的 geohash 键，行号越大键越大
+         *
+         */
+        uint64_t geohash_key(size_t row) const { return geohash_keys_[row]; }
+
+        /**
+         * @brief 二分查找 geohash 键在 [lo, hi) 内的行，结果为连续的行号区间 [*begin, *end)
+         *
+         */
+        void FindGeohashRange(uint64_t lo, uint64_t hi, size_t *begin, size_t *end) const;
+
+        /**
+         * @brief 第 row 行 feature 预先编码好的 protobuf 二进制数据，可以直接作为 Feature 消息体发送
+         *
+         */
+        const char *wire_data(size_t row) const { return wire_.data() + wire_offset_[row]; }
+        size_t wire_size(size_t row) const { return wire_offset_[row + 1] - wire_offset_[row]; }
+
+    private:
+        explicit FeatureDb(uint64_t version);
+
+        bool LoadSnapshot(SnapshotReader *reader);
+
+        /**
+         * @brief 按 geohash 键对 store_ 重新排序，键相同时保持原来的顺序，并记录每行的键
+         *
+         */
+        void SortByGeohash();
+
+        /**
+         * @brief 根据 store_ 构建精确位置查找索引、矩形范围查询索引、空间分区、名称检索索引以及每个 feature 的单位向量
+         *
+         */
+        void BuildIndexes();
+
+        /**
+         * @brief 把每个 feature 编码为 protobuf 二进制数据，首尾相接存放在 wire_ 中
+         *
+         */
+        void EncodeFeatures();
+
+        uint64_t version_;
+        std::unique_ptr<MappedFile> snapshot_file_; // 从快照打开时为映射的快照文件，以下数组都引用其中的数据
+        FeatureStore store_;                   // 列式存储的 feature 数据，按 geohash 键排序
+        FlatArray<uint64_t> geohash_keys_;     // 每行的 geohash 键，升序
+        PointIndex point_index_;               // (latitude, longitude) -> store_ 行号
+        BloomFilter bloom_filter_;             // 所有位置的布隆过滤器，精确查找前快速排除不存在的位置
+        double bloom_false_positive_rate_;
+        SpatialIndex spatial_index_;           // 矩形范围查询 R 树，条目为 store_ 行号
+        std::vector<FeaturePartition> partitions_;
+        FlatArray<UnitVector> unit_vectors_;   // 每个 feature 在单位球面上的坐标，用于半径查询
+        NameIndex name_index_;                 // 名称前缀和子串检索索引
+        FlatArray<uint64_t> wire_offset_;      // size()+1 个元素，第 i 个编码为 [wire_offset_[i], wire_offset_[i+1])
+        FlatArray<char> wire_;                 // 所有 feature 的编码首尾相接存放
+    };
+
+    /**
+     * @brief 加载数据库文件：二进制快照直接打开，JSON、NDJSON 和 protobuf 流解析后构建索引，格式见 DetectDbFormat
+     *
+     * @param db_path 数据库文件路径
+     * @param version 快照版本号
+     * @param load_threads 解析 JSON 的线程数，0 表示使用 CPU 核数，1 表示单线程解析
+     * @return std::shared_ptr<const FeatureDb> 文件无法打开或快照无效时返回空指针
+     */
+    std::shared_ptr<const FeatureDb> LoadFeatureDb(const std::string &db_path, uint64_t version,
+                                                   size_t load_threads = 0);
+
+} // namespace routeguide
+
+#endif //_FEATURE_DB_H_
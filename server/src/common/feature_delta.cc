@@ -0,0 +1,64 @@
+#include "feature_delta.h"
+#include "point_index.h"
+
+#include "route_guide.grpc.pb.h"
+
+namespace routeguide
+{
+    void DeltaEntry::ToFeature(Feature *feature) const
+    {
+        feature->set_name(name);
+        feature->mutable_location()->set_latitude(latitude);
+        feature->mutable_location()->set_longitude(longitude);
+    }
+
+    const size_t FeatureDelta::kMinRecent;
+
+    std::shared_ptr<const FeatureDelta> FeatureDelta::With(const DeltaEntry &entry) const
+    {
+        uint64_t key = PackPoint(entry.latitude, entry.longitude);
+        std::shared_ptr<FeatureDelta> delta = std::make_shared<FeatureDelta>();
+        delta->size_ = Find(key) == nullptr ? size_ + 1 : size_;
+        delta->max_seq_ = entry.seq > max_seq_ ? entry.seq : max_seq_;
+
+        if (recent_.size() + 1 >= kMinRecent && (recent_.size() + 1) * (recent_.size() + 1) >= frozen_->size())
+        {
+            // recent_ 已经足够大，连同新记录一起并入新的 frozen_，代价 O(n) 但约每 sqrt(n) 次修改才发生一次
+            std::shared_ptr<EntryMap> frozen = std::make_shared<EntryMap>(*frozen_);
+            for (const EntryMap::value_type &item : recent_)
+            {
+                (*frozen)[item.first] = item.second;
+            }
+            (*frozen)[key] = entry;
+            delta->frozen_ = frozen;
+        }
+        else
+        {
+            delta->frozen_ = frozen_;
+            delta->recent_ = recent_;
+            delta->recent_[key] = entry;
+        }
+        return delta;
+    }
+
+    std::shared_ptr<const FeatureDelta> FeatureDelta::Since(uint64_t merged_seq) const
+    {
+        std::shared_ptr<FeatureDelta> delta = std::make_shared<FeatureDelta>();
+        std::shared_ptr<EntryMap> frozen = std::make_shared<EntryMap>();
+        for (const EntryMap::value_type &item : entries())
+        {
+            if (item.second.seq > merged_seq)
+            {
+                frozen->insert(item);
+                if (item.second.seq > delta->max_seq_)
+                {
+                    delta->max_seq_ = item.second.seq;
+                }
+            }
+        }
+        delta->size_ = frozen->size();
+        delta->frozen_ = frozen;
+        return delta;
+    }
+
+} // namespace routeguide
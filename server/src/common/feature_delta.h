@@ -0,0 +1,165 @@
+/**
+ * @file feature_delta.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 增量层：记录主库快照之后的新增、修改和删除，按位置覆盖主库中的 feature
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _FEATURE_DELTA_H_
+#define _FEATURE_DELTA_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace routeguide
+{
+    class Feature;
+
+    /**
+     * @brief 增量层中的一条记录，同一位置只保留最后一次修改
+     *
+     */
+    struct DeltaEntry
+    {
+        uint64_t seq;     // 修改序号，全局递增
+        bool deleted;     // true 表示删除该位置的 feature
+        int32_t latitude;
+        int32_t longitude;
+        std::string name; // 新增或修改后的名称，删除时为空
+
+        void ToFeature(Feature *feature) const;
+    };
+
+    /**
+     * @brief 只读的增量层。
+     * 修改时复制一份再写入新记录（写时复制），已发布的增量层不会再被修改，读取端无需加锁。
+     * 记录分两级存放：较大的 frozen_ 由多个版本共享，只有较小的 recent_ 在每次修改时复制；
+     * recent_ 增长到约 sqrt(frozen_ 大小) 时整体并入新的 frozen_，
+     * 因此每次修改的平均复制代价约为 O(sqrt(n))，而不是复制整个增量层。
+     *
+     */
+    class FeatureDelta
+    {
+    public:
+        typedef std::unordered_map<uint64_t, DeltaEntry> EntryMap; // PackPoint(lat, lon) -> 记录
+
+        // recent_ 至少积累这么多条记录才并入 frozen_，避免增量层较小时频繁重建
+        static const size_t kMinRecent = 64;
+
+        /**
+         * @brief 依次访问每个位置的最新记录：先遍历 recent_，再遍历 frozen_ 中未被 recent_ 覆盖的记录
+         *
+         */
+        class const_iterator
+        {
+        public:
+            const_iterator(const FeatureDelta *delta, bool in_recent, EntryMap::const_iterator it)
+                : delta_(delta), in_recent_(in_recent), it_(it)
+            {
+                Settle();
+            }
+
+            const EntryMap::value_type &operator*() const { return *it_; }
+            const EntryMap::value_type *operator->() const { return &*it_; }
+
+            const_iterator &operator++()
+            {
+                ++it_;
+                Settle();
+                return *this;
+            }
+
+            bool operator==(const const_iterator &other) const
+            {
+                return in_recent_ == other.in_recent_ && it_ == other.it_;
+            }
+            bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+        private:
+            // 跳到下一个有效位置：recent_ 遍历完转到 frozen_，并跳过 frozen_ 中已被覆盖的记录
+            void Settle()
+            {
+                if (in_recent_ && it_ == delta_->recent_.end())
+                {
+                    in_recent_ = false;
+                    it_ = delta_->frozen_->begin();
+                }
+                while (!in_recent_ && it_ != delta_->frozen_->end() && delta_->recent_.count(it_->first) > 0)
+                {
+                    ++it_;
+                }
+            }
+
+            const FeatureDelta *delta_;
+            bool in_recent_;
+            EntryMap::const_iterator it_;
+        };
+
+        /**
+         * @brief 可以用于 range-based for 的记录区间
+         *
+         */
+        class EntryRange
+        {
+        public:
+            explicit EntryRange(const FeatureDelta *delta) : delta_(delta) {}
+            const_iterator begin() const { return const_iterator(delta_, true, delta_->recent_.begin()); }
+            const_iterator end() const { return const_iterator(delta_, false, delta_->frozen_->end()); }
+
+        private:
+            const FeatureDelta *delta_;
+        };
+
+        FeatureDelta() : frozen_(std::make_shared<const EntryMap>()), size_(0), max_seq_(0) {}
+
+        bool empty() const { return size_ == 0; }
+        size_t size() const { return size_; }
+        uint64_t max_seq() const { return max_seq_; }
+        EntryRange entries() const { return EntryRange(this); }
+
+        /**
+         * @brief 查找某个位置的记录
+         *
+         * @return const DeltaEntry* 没有记录时返回 nullptr
+         */
+        const DeltaEntry *Find(uint64_t key) const
+        {
+            if (size_ == 0)
+            {
+                return nullptr;
+            }
+            EntryMap::const_iterator it = recent_.find(key);
+            if (it != recent_.end())
+            {
+                return &it->second;
+            }
+            it = frozen_->find(key);
+            return it == frozen_->end() ? nullptr : &it->second;
+        }
+
+        /**
+         * @brief 返回写入 entry 之后的新增量层，当前对象不变
+         *
+         */
+        std::shared_ptr<const FeatureDelta> With(const DeltaEntry &entry) const;
+
+        /**
+         * @brief 返回只包含 seq 大于 merged_seq 的记录的新增量层，用于合并到主库之后
+         *
+         */
+        std::shared_ptr<const FeatureDelta> Since(uint64_t merged_seq) const;
+
+    private:
+        std::shared_ptr<const EntryMap> frozen_; // 多个版本共享，创建后不再修改
+        EntryMap recent_;                        // 优先于 frozen_ 中同一位置的记录
+        size_t size_;                            // 不同位置的个数
+        uint64_t max_seq_;
+    };
+
+} // namespace routeguide
+
+#endif //_FEATURE_DELTA_H_
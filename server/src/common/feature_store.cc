@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "feature_store.h"
+#include "db_snapshot.h"
+
+#include "route_guide.grpc.pb.h"
+
+namespace routeguide
+{
+    void FeatureStore::Reserve(size_t features, size_t name_bytes)
+    {
+        lat_.reserve(features);
+        lon_.reserve(features);
+        name_offset_.reserve(features + 1);
+        names_.reserve(name_bytes);
+    }
+
+    uint32_t FeatureStore::Add(int32_t latitude, int32_t longitude, const char *name, size_t name_size)
+    {
+        uint32_t row = static_cast<uint32_t>(lat_.size());
+        lat_.push_back(latitude);
+        lon_.push_back(longitude);
+        names_.append(name, name_size);
+        name_offset_.push_back(names_.size());
+        return row;
+    }
+
+    void FeatureStore::Append(const FeatureStore &other)
+    {
+        uint64_t base = names_.size();
+        size_t rows = size();
+        lat_.append(other.lat_.data(), other.size());
+        lon_.append(other.lon_.data(), other.size());
+        names_.append(other.names_.data(), other.names_.size());
+        name_offset_.resize(rows + other.size() + 1);
+        uint64_t *offsets = name_offset_.mutable_data() + rows + 1;
+        for (size_t i = 0; i < other.size(); i++)
+        {
+            offsets[i] = base + other.name_offset_[i + 1];
+        }
+    }
+
+    void FeatureStore::Clear()
+    {
+        lat_.clear();
+        lon_.clear();
+        name_offset_.assign(1, 0);
+        names_.clear();
+    }
+
+    void FeatureStore::Permute(const std::vector<uint32_t> &order)
+    {
+        FeatureStore permuted;
+        permuted.Reserve(order.size(), names_.size());
+        for (uint32_t row : order)
+        {
+            permuted.Add(lat_[row], lon_[row], name_data(row), name_size(row));
+        }
+        *this = std::move(permuted);
+    }
+
+    void FeatureStore::ShrinkToFit()
+    {
+        lat_.shrink_to_fit();
+        lon_.shrink_to_fit();
+        name_offset_.shrink_to_fit();
+        names_.shrink_to_fit();
+    }
+
+    void FeatureStore::ToFeature(size_t row, Feature *feature) const
+    {
+        feature->set_name(name_data(row), name_size(row));
+        feature->mutable_location()->set_latitude(lat_[row]);
+        feature->mutable_location()->set_longitude(lon_[row]);
+    }
+
+    size_t FeatureStore::MemoryUsage() const
+    {
+        return lat_.capacity() * sizeof(int32_t) + lon_.capacity() * sizeof(int32_t) +
+               name_offset_.capacity() * sizeof(uint64_t) + names_.capacity();
+    }
+
+    void FeatureStore::Save(SnapshotWriter *writer) const
+    {
+        writer->Write(kTagLatitude, lat_);
+        writer->Write(kTagLongitude, lon_);
+        writer->Write(kTagNameOffset, name_offset_);
+        writer->Write(kTagNames, names_);
+    }
+
+    bool FeatureStore::Load(SnapshotReader *reader)
+    {
+        if (!reader->Read(kTagLatitude, &lat_) || !reader->Read(kTagLongitude, &lon_) ||
+            !reader->Read(kTagNameOffset, &name_offset_) || !reader->Read(kTagNames, &names_))
+        {
+            return false;
+        }
+        if (lon_.size() != lat_.size() || name_offset_.size() != lat_.size() + 1 || name_offset_[0] != 0 ||
+            name_offset_.back() != names_.size())
+        {
+            return reader->Fail("inconsistent feature columns");
+        }
+        // 偏移必须单调不减，否则 name() 会算出负长度或越过名称区
+        if (!std::is_sorted(name_offset_.begin(), name_offset_.end()))
+        {
+            return reader->Fail("bad name offsets");
+        }
+        return true;
+    }
+
+} // namespace routeguide
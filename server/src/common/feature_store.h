@@ -0,0 +1,124 @@
+/**
+ * @file feature_store.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 列式 feature 存储：经纬度分别存放在连续的 int32 数组中，名称集中存放在一块连续内存中
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _FEATURE_STORE_H_
+#define _FEATURE_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "flat_array.h"
+
+namespace routeguide
+{
+    class Feature;
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /**
+     * @brief 列式(struct-of-arrays) feature 存储。
+     * 与 std::vector<Feature> 相比，每个 feature 只占 8 字节坐标 + 8 字节名称偏移 + 名称本身，
+     * 范围扫描只读取连续的坐标列，只有在写返回结果时才构造 Feature 消息。
+     *
+     */
+    class FeatureStore
+    {
+    public:
+        FeatureStore() : name_offset_(1, 0) {}
+
+        /**
+         * @brief 预分配空间
+         *
+         * @param features 预计 feature 个数
+         * @param name_bytes 预计名称总字节数
+         */
+        void Reserve(size_t features, size_t name_bytes);
+
+        /**
+         * @brief 追加一个 feature
+         *
+         * @return uint32_t 新 feature 的行号
+         */
+        uint32_t Add(int32_t latitude, int32_t longitude, const char *name, size_t name_size);
+
+        uint32_t Add(int32_t latitude, int32_t longitude, const std::string &name)
+        {
+            return Add(latitude, longitude, name.data(), name.size());
+        }
+
+        /**
+         * @brief 把 other 的全部行按顺序追加到末尾，用于合并并行解析得到的各块，other 不能是自身
+         *
+         */
+        void Append(const FeatureStore &other);
+
+        void Clear();
+
+        /**
+         * @brief 按 order 重新排列所有行，新的第 i 行为原来的第 order[i] 行
+         *
+         * @param order 原行号的一个排列，长度必须等于 size()
+         */
+        void Permute(const std::vector<uint32_t> &order);
+
+        /**
+         * @brief 释放预分配但未使用的空间
+         *
+         */
+        void ShrinkToFit();
+
+        size_t size() const { return lat_.size(); }
+        bool empty() const { return lat_.empty(); }
+
+        int32_t latitude(size_t row) const { return lat_[row]; }
+        int32_t longitude(size_t row) const { return lon_[row]; }
+        const int32_t *latitudes() const { return lat_.data(); }
+        const int32_t *longitudes() const { return lon_.data(); }
+
+        const char *name_data(size_t row) const { return names_.data() + name_offset_[row]; }
+        size_t name_size(size_t row) const { return name_offset_[row + 1] - name_offset_[row]; }
+        std::string name(size_t row) const { return std::string(name_data(row), name_size(row)); }
+        size_t name_bytes() const { return names_.size(); }
+
+        /**
+         * @brief 将第 row 行填充到 Feature 消息中，用于写返回结果
+         *
+         */
+        void ToFeature(size_t row, Feature *feature) const;
+
+        /**
+         * @brief 存储占用的内存字节数（按容量计算）
+         *
+         */
+        size_t MemoryUsage() const;
+
+        /**
+         * @brief 写入快照
+         *
+         */
+        void Save(SnapshotWriter *writer) const;
+
+        /**
+         * @brief 从快照读取，各列直接引用快照文件的映射，之后的修改会先复制出自己的数据
+         *
+         */
+        bool Load(SnapshotReader *reader);
+
+    private:
+        FlatArray<int32_t> lat_;
+        FlatArray<int32_t> lon_;
+        FlatArray<uint64_t> name_offset_; // size()+1 个元素，第 i 个名称为 [name_offset_[i], name_offset_[i+1])
+        FlatArray<char> names_;           // 所有名称首尾相接存放
+    };
+
+} // namespace routeguide
+
+#endif //_FEATURE_STORE_H_
@@ -0,0 +1,191 @@
+/**
+ * @file flat_array.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 连续数组：可以持有自己的数据，也可以直接引用外部只读内存（如映射的快照文件）
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _FLAT_ARRAY_H_
+#define _FLAT_ARRAY_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace routeguide
+{
+    /**
+     * @brief 元素连续存放的数组，接口与 std::vector 的常用部分一致。
+     * 默认数据保存在内部的 std::vector 中；Borrow() 之后改为引用外部内存，不复制、不释放，
+     * 调用方保证外部内存在数组使用期间有效。引用外部内存时任何修改操作都会先把数据复制到内部。
+     * 读取接口只有 const 版本，只通过缓存的指针和长度访问，两种状态下没有额外分支；
+     * 按下标写入需要显式调用 mutable_data()，避免在非 const 成员函数中读取时意外复制整个数组。
+     * T 必须是可以按字节复制的类型。
+     *
+     */
+    template <typename T>
+    class FlatArray
+    {
+    public:
+        FlatArray() : data_(nullptr), size_(0), borrowed_(false) {}
+        FlatArray(size_t n, const T &value) : owned_(n, value), borrowed_(false) { Sync(); }
+
+        // 复制时总是复制出一份自己的数据，避免副本比外部内存活得更久
+        FlatArray(const FlatArray &other) : owned_(other.begin(), other.end()), borrowed_(false) { Sync(); }
+
+        FlatArray(FlatArray &&other) noexcept
+            : owned_(std::move(other.owned_)), data_(other.data_), size_(other.size_), borrowed_(other.borrowed_)
+        {
+            Sync();
+            other.Reset();
+        }
+
+        FlatArray &operator=(const FlatArray &other)
+        {
+            if (this != &other)
+            {
+                owned_.assign(other.begin(), other.end());
+                borrowed_ = false;
+                Sync();
+            }
+            return *this;
+        }
+
+        FlatArray &operator=(FlatArray &&other) noexcept
+        {
+            if (this != &other)
+            {
+                owned_ = std::move(other.owned_);
+                data_ = other.data_;
+                size_ = other.size_;
+                borrowed_ = other.borrowed_;
+                Sync();
+                other.Reset();
+            }
+            return *this;
+        }
+
+        /**
+         * @brief 释放自己的数据，改为引用 [data, data + n)
+         *
+         */
+        void Borrow(const T *data, size_t n)
+        {
+            std::vector<T>().swap(owned_);
+            data_ = data;
+            size_ = n;
+            borrowed_ = true;
+        }
+
+        bool borrowed() const { return borrowed_; }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        /**
+         * @brief 占用的元素个数：自己的数据按容量计算，引用外部内存时为长度
+         *
+         */
+        size_t capacity() const { return borrowed_ ? size_ : owned_.capacity(); }
+
+        const T *data() const { return data_; }
+        const T &operator[](size_t i) const { return data_[i]; }
+        const T *begin() const { return data_; }
+        const T *end() const { return data_ + size_; }
+        const T &front() const { return data_[0]; }
+        const T &back() const { return data_[size_ - 1]; }
+
+        /**
+         * @brief 可写的数据指针，引用外部内存时先复制出自己的数据
+         *
+         */
+        T *mutable_data() { return Own().data(); }
+
+        void reserve(size_t n)
+        {
+            Own().reserve(n);
+            Sync();
+        }
+
+        void resize(size_t n)
+        {
+            Own().resize(n);
+            Sync();
+        }
+
+        void assign(size_t n, const T &value)
+        {
+            borrowed_ = false;
+            owned_.assign(n, value);
+            Sync();
+        }
+
+        void clear()
+        {
+            borrowed_ = false;
+            owned_.clear();
+            Sync();
+        }
+
+        void push_back(const T &value)
+        {
+            Own().push_back(value);
+            Sync();
+        }
+
+        void append(const T *values, size_t n)
+        {
+            Own().insert(owned_.end(), values, values + n);
+            Sync();
+        }
+
+        void shrink_to_fit()
+        {
+            Own().shrink_to_fit();
+            Sync();
+        }
+
+        void swap(std::vector<T> &other)
+        {
+            Own().swap(other);
+            Sync();
+        }
+
+    private:
+        std::vector<T> &Own()
+        {
+            if (borrowed_)
+            {
+                owned_.assign(data_, data_ + size_);
+                borrowed_ = false;
+                Sync();
+            }
+            return owned_;
+        }
+
+        void Sync()
+        {
+            if (!borrowed_)
+            {
+                data_ = owned_.data();
+                size_ = owned_.size();
+            }
+        }
+
+        void Reset()
+        {
+            owned_.clear();
+            borrowed_ = false;
+            Sync();
+        }
+
+        std::vector<T> owned_;
+        const T *data_; // 指向 owned_ 或外部内存
+        size_t size_;
+        bool borrowed_;
+    };
+
+} // namespace routeguide
+
+#endif //_FLAT_ARRAY_H_
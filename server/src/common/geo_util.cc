@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#include "geo_util.h"
+
+#include "route_guide.grpc.pb.h"
+
+namespace routeguide
+{
+    namespace
+    {
+        const double kRadiansPerE7 = M_PI / 180 / kCoordFactor;
+
+        // 线段切分时每段的最短长度（米），避免半径很小时切出过多的包围盒
+        const double kMinSegmentPiece = 500.0;
+        // 每条线段最多切分的段数，超长线段每段相应变长
+        const double kMaxSegmentPieces = 4096;
+        // float 单位向量计算出的弦长的误差上界（约 6 米），实际误差在 1e-7 量级，留足余量
+        const double kChordError = 1e-6;
+
+        /**
+         * @brief 双精度单位向量，线段距离计算需要比 UnitVector 更高的精度
+         *
+         */
+        struct Vector3
+        {
+            double x;
+            double y;
+            double z;
+        };
+
+        Vector3 ToVector3(int32_t lat, int32_t lon)
+        {
+            double phi = lat * kRadiansPerE7;
+            double lambda = lon * kRadiansPerE7;
+            Vector3 v = {std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi)};
+            return v;
+        }
+
+        Vector3 Cross(const Vector3 &a, const Vector3 &b)
+        {
+            Vector3 v = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+            return v;
+        }
+
+        double Dot(const Vector3 &a, const Vector3 &b)
+        {
+            return a.x * b.x + a.y * b.y + a.z * b.z;
+        }
+
+        double Norm(const Vector3 &v)
+        {
+            return std::sqrt(Dot(v, v));
+        }
+
+        // 两个单位向量之间的夹角，atan2 形式在夹角很小或接近 180 度时都稳定
+        double Angle(const Vector3 &a, const Vector3 &b)
+        {
+            return std::atan2(Norm(Cross(a, b)), Dot(a, b));
+        }
+
+        const char kGeohashAlphabet[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+        const int kGeohashBitsPerAxis = 30;
+        const int kGeohashBits = kGeohashBitsPerAxis * 2;
+
+        /**
+         * @brief 把 [min, max] 内的值等分量化为 30 位整数，max 归入最后一格，超出范围的值按边界处理
+         *
+         */
+        uint64_t Quantize(int32_t value, int64_t min, int64_t max)
+        {
+            uint64_t cells = uint64_t(1) << kGeohashBitsPerAxis;
+            int64_t offset = std::max<int64_t>(0, std::min<int64_t>(value - min, max - min));
+            uint64_t cell = static_cast<uint64_t>(offset) * cells / static_cast<uint64_t>(max - min);
+            return std::min(cell, cells - 1);
+        }
+
+        /**
+         * @brief 把 32 位整数的每一位间隔一位展开到 64 位整数的偶数位上
+         *
+         */
+        uint64_t SpreadBits(uint64_t v)
+        {
+            v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+            v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+            v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            v = (v | (v << 2)) & 0x3333333333333333ULL;
+            v = (v | (v << 1)) & 0x5555555555555555ULL;
+            return v;
+        }
+    } // namespace
+
+    float ConvertToRadians(float num)
+    {
+        return num * 3.1415926 / 180;
+    }
+
+    // The formula is based on http://mathforum.org/library/drmath/view/51879.html
+    float GetDistance(int32_t start_lat, int32_t start_lon, int32_t end_lat, int32_t end_lon)
+    {
+        float lat_1 = start_lat / kCoordFactor;
+        float lat_2 = end_lat / kCoordFactor;
+        float lon_1 = start_lon / kCoordFactor;
+        float lon_2 = end_lon / kCoordFactor;
+        float lat_rad_1 = ConvertToRadians(lat_1);
+        float lat_rad_2 = ConvertToRadians(lat_2);
+        float delta_lat_rad = ConvertToRadians(lat_2 - lat_1);
+        float delta_lon_rad = ConvertToRadians(lon_2 - lon_1);
+
+        // 平方直接相乘，避免 pow 调用
+        double sin_half_lat = sin(delta_lat_rad / 2);
+        double sin_half_lon = sin(delta_lon_rad / 2);
+        float a = sin_half_lat * sin_half_lat + cos(lat_rad_1) * cos(lat_rad_2) *
+                                                    (sin_half_lon * sin_half_lon);
+        float c = 2 * atan2(sqrt(a), sqrt(1 - a));
+
+        return kEarthRadius * c;
+    }
+
+    float GetDistance(const Point &start, const Point &end)
+    {
+        return GetDistance(start.latitude(), start.longitude(), end.latitude(), end.longitude());
+    }
+
+    double GetDistanceLowerBound(int32_t lat, int32_t lon, const BoundingBox &box)
+    {
+        const double kRadiansPerE7 = M_PI / 180 / kCoordFactor;
+        double phi = lat * kRadiansPerE7;
+
+        // 纬度方向：任何路径改变的纬度都不超过走过的弧长
+        double lat_gap = 0;
+        if (lat < box.min_lat)
+        {
+            lat_gap = (static_cast<double>(box.min_lat) - lat) * kRadiansPerE7;
+        }
+        else if (lat > box.max_lat)
+        {
+            lat_gap = (static_cast<double>(lat) - box.max_lat) * kRadiansPerE7;
+        }
+        double bound = lat_gap;
+
+        // 经度方向：到经线所在大圆的距离为 asin(cos(phi) * |sin(delta_lon)|)。
+        // 当包围盒经度范围既不包含该点经度，也不包含其对跖经线时，最小值在两条边界经线上取得
+        if (lon < box.min_lon || lon > box.max_lon)
+        {
+            int64_t antipode = lon <= 0 ? static_cast<int64_t>(lon) + 1800000000LL
+                                        : static_cast<int64_t>(lon) - 1800000000LL;
+            if (antipode < box.min_lon || antipode > box.max_lon)
+            {
+                double cos_phi = std::cos(phi);
+                double to_min = std::fabs(std::sin((static_cast<double>(lon) - box.min_lon) * kRadiansPerE7));
+                double to_max = std::fabs(std::sin((static_cast<double>(lon) - box.max_lon) * kRadiansPerE7));
+                double cross_track = std::asin(std::min(1.0, cos_phi * std::min(to_min, to_max)));
+                bound = std::max(bound, cross_track);
+            }
+        }
+
+        // GetDistance 使用 float 计算，留出足够的误差余量，保证下界不会超过其结果
+        return std::max(0.0, bound * kEarthRadius * 0.999 - 5.0);
+    }
+
+    UnitVector ToUnitVector(int32_t lat, int32_t lon)
+    {
+        const double kRadiansPerE7 = M_PI / 180 / kCoordFactor;
+        double phi = lat * kRadiansPerE7;
+        double lambda = lon * kRadiansPerE7;
+        UnitVector v;
+        v.x = static_cast<float>(std::cos(phi) * std::cos(lambda));
+        v.y = static_cast<float>(std::cos(phi) * std::sin(lambda));
+        v.z = static_cast<float>(std::sin(phi));
+        return v;
+    }
+
+    float RadiusToChordSquared(double radius)
+    {
+        double angle = std::min(M_PI, radius / kEarthRadius);
+        double chord = 2 * std::sin(angle / 2);
+        return static_cast<float>(chord * chord);
+    }
+
+    RadiusFilter::RadiusFilter(int32_t lat, int32_t lon, double radius)
+        : lat_(lat), lon_(lon), center_(ToUnitVector(lat, lon)), angle_(std::min(M_PI, radius / kEarthRadius))
+    {
+        double chord = 2 * std::sin(angle_ / 2);
+        double inner = std::max(0.0, chord - kChordError);
+        double outer = chord + kChordError;
+        inner_squared_ = static_cast<float>(inner * inner);
+        outer_squared_ = static_cast<float>(outer * outer);
+    }
+
+    bool RadiusFilter::Contains(int32_t lat, int32_t lon, const UnitVector &unit_vector) const
+    {
+        float chord_squared = ChordDistanceSquared(center_, unit_vector);
+        if (chord_squared < inner_squared_)
+        {
+            return true;
+        }
+        if (chord_squared > outer_squared_)
+        {
+            return false;
+        }
+        return Angle(ToVector3(lat_, lon_), ToVector3(lat, lon)) <= angle_;
+    }
+
+    void GetRadiusBoundingBoxes(int32_t lat, int32_t lon, double radius, std::vector<BoundingBox> *boxes)
+    {
+        const double kRadiansPerE7 = M_PI / 180 / kCoordFactor;
+        const int64_t kMaxLat = 900000000LL;
+        const int64_t kMaxLon = 1800000000LL;
+
+        double angle = radius / kEarthRadius;
+        double phi = lat * kRadiansPerE7;
+        double min_phi = phi - angle;
+        double max_phi = phi + angle;
+
+        BoundingBox box;
+        box.min_lat = static_cast<int32_t>(std::max<int64_t>(-kMaxLat, static_cast<int64_t>(std::floor(min_phi / kRadiansPerE7))));
+        box.max_lat = static_cast<int32_t>(std::min<int64_t>(kMaxLat, static_cast<int64_t>(std::ceil(max_phi / kRadiansPerE7))));
+        if (min_phi <= -M_PI / 2 || max_phi >= M_PI / 2 || angle >= M_PI / 2)
+        {
+            // 圆覆盖了极点，经度方向无法收缩
+            box.min_lon = static_cast<int32_t>(-kMaxLon);
+            box.max_lon = static_cast<int32_t>(kMaxLon);
+            boxes->push_back(box);
+            return;
+        }
+
+        // 圆在经度方向上的最大跨度，见 http://janmatuschek.de/LatitudeLongitudeBoundingCoordinates
+        double delta_lambda = std::asin(std::min(1.0, std::sin(angle) / std::cos(phi)));
+        int64_t delta_lon = static_cast<int64_t>(std::ceil(delta_lambda / kRadiansPerE7));
+        int64_t min_lon = static_cast<int64_t>(lon) - delta_lon;
+        int64_t max_lon = static_cast<int64_t>(lon) + delta_lon;
+        if (min_lon < -kMaxLon)
+        {
+            BoundingBox wrapped = box;
+            wrapped.min_lon = static_cast<int32_t>(min_lon + 2 * kMaxLon);
+            wrapped.max_lon = static_cast<int32_t>(kMaxLon);
+            boxes->push_back(wrapped);
+            min_lon = -kMaxLon;
+        }
+        if (max_lon > kMaxLon)
+        {
+            BoundingBox wrapped = box;
+            wrapped.min_lon = static_cast<int32_t>(-kMaxLon);
+            wrapped.max_lon = static_cast<int32_t>(max_lon - 2 * kMaxLon);
+            boxes->push_back(wrapped);
+            max_lon = kMaxLon;
+        }
+        box.min_lon = static_cast<int32_t>(min_lon);
+        box.max_lon = static_cast<int32_t>(max_lon);
+        boxes->push_back(box);
+    }
+
+    void GetSegmentBoundingBoxes(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2, double radius,
+                                 std::vector<BoundingBox> *boxes)
+    {
+        Vector3 a = ToVector3(lat1, lon1);
+        Vector3 b = ToVector3(lat2, lon2);
+        double angle = Angle(a, b);
+        if (angle > M_PI - 1e-9)
+        {
+            // 端点互为对跖点，经过两点的大圆不唯一，只能覆盖整个球面
+            BoundingBox world = {-900000000, 900000000, -1800000000, 1800000000};
+            boxes->push_back(world);
+            return;
+        }
+
+        double length = angle * kEarthRadius;
+        double pieces = std::min(kMaxSegmentPieces,
+                                 std::max(1.0, std::ceil(length / std::max(2 * radius, kMinSegmentPiece))));
+        double piece_length = length / pieces;
+        double sin_angle = std::sin(angle);
+        for (double k = 0; k < pieces; k++)
+        {
+            // 球面线性插值得到第 k 段的中点
+            double t = (k + 0.5) / pieces;
+            Vector3 mid = a;
+            if (sin_angle > 1e-12)
+            {
+                double wa = std::sin((1 - t) * angle) / sin_angle;
+                double wb = std::sin(t * angle) / sin_angle;
+                mid.x = wa * a.x + wb * b.x;
+                mid.y = wa * a.y + wb * b.y;
+                mid.z = wa * a.z + wb * b.z;
+            }
+            int32_t mid_lat = static_cast<int32_t>(std::lround(std::atan2(mid.z, std::hypot(mid.x, mid.y)) / kRadiansPerE7));
+            int32_t mid_lon = static_cast<int32_t>(std::lround(std::atan2(mid.y, mid.x) / kRadiansPerE7));
+            // 多留 1 米，抵消中点坐标取整的误差
+            GetRadiusBoundingBoxes(mid_lat, mid_lon, radius + piece_length / 2 + 1.0, boxes);
+        }
+    }
+
+    uint64_t GetGeohashKey(int32_t lat, int32_t lon)
+    {
+        // geohash 的最高位是经度，因此经度放在奇数位
+        return SpreadBits(Quantize(lon, -1800000000, 1800000000)) << 1 |
+               SpreadBits(Quantize(lat, -900000000, 900000000));
+    }
+
+    bool GetGeohashRange(const std::string &prefix, uint64_t *lo, uint64_t *hi)
+    {
+        if (prefix.empty() || prefix.size() > kGeohashMaxLength)
+        {
+            return false;
+        }
+        uint64_t value = 0;
+        for (char c : prefix)
+        {
+            const char *pos = std::strchr(kGeohashAlphabet, std::tolower(static_cast<unsigned char>(c)));
+            if (c == '\0' || pos == nullptr)
+            {
+                return false;
+            }
+            value = value << 5 | static_cast<uint64_t>(pos - kGeohashAlphabet);
+        }
+        int shift = kGeohashBits - static_cast<int>(prefix.size()) * 5;
+        *lo = value << shift;
+        *hi = (value + 1) << shift;
+        return true;
+    }
+
+    std::string EncodeGeohash(uint64_t key, size_t length)
+    {
+        std::string hash;
+        for (size_t i = 0; i < length && i < kGeohashMaxLength; i++)
+        {
+            hash.push_back(kGeohashAlphabet[(key >> (kGeohashBits - 5 * (i + 1))) & 31]);
+        }
+        return hash;
+    }
+
+    double GetDistanceToSegment(int32_t lat, int32_t lon, int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+    {
+        Vector3 p = ToVector3(lat, lon);
+        Vector3 a = ToVector3(lat1, lon1);
+        Vector3 b = ToVector3(lat2, lon2);
+
+        // 点在线段所在大圆上的投影落在 a、b 之间时，距离即到大圆的距离，否则取到较近端点的距离
+        Vector3 normal = Cross(a, b);
+        double norm = Norm(normal);
+        if (norm > 1e-12)
+        {
+            normal.x /= norm;
+            normal.y /= norm;
+            normal.z /= norm;
+            if (Dot(Cross(a, p), normal) >= 0 && Dot(Cross(p, b), normal) >= 0)
+            {
+                return std::asin(std::min(1.0, std::fabs(Dot(p, normal)))) * kEarthRadius;
+            }
+        }
+        return std::min(Angle(p, a), Angle(p, b)) * kEarthRadius;
+    }
+
+} // namespace routeguide
@@ -0,0 +1,160 @@
+/**
+ * @file geo_util.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 地理距离计算相关函数
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _GEO_UTIL_H_
+#define _GEO_UTIL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spatial_index.h"
+
+namespace routeguide
+{
+    class Point;
+
+    const float kCoordFactor = 10000000.0;
+    const int kEarthRadius = 6371000; // metres
+
+    // geohash 最多支持的字符数，每个字符 5 位，12 个字符共 60 位
+    const size_t kGeohashMaxLength = 12;
+
+    float ConvertToRadians(float num);
+
+    /**
+     * @brief 判断 E7 表示的经纬度是否在合法范围内（纬度 ±90 度，经度 ±180 度）
+     *
+     */
+    inline bool IsValidLocation(int32_t lat, int32_t lon)
+    {
+        return lat >= -900000000 && lat <= 900000000 && lon >= -1800000000 && lon <= 1800000000;
+    }
+
+    /**
+     * @brief 计算两个位置之间的大圆距离（haversine 公式）
+     *
+     * @return float 距离，单位米
+     */
+    float GetDistance(const Point &start, const Point &end);
+    float GetDistance(int32_t start_lat, int32_t start_lon, int32_t end_lat, int32_t end_lon);
+
+    /**
+     * @brief 计算位置到包围盒内任意一点的大圆距离下界，用于最近邻搜索时剪枝。
+     * 结果保证不大于 GetDistance 对包围盒内任意一点的计算结果。
+     *
+     * @return double 距离下界，单位米
+     */
+    double GetDistanceLowerBound(int32_t lat, int32_t lon, const BoundingBox &box);
+
+    /**
+     * @brief 位置在单位球面上的三维坐标。两点间弦长与大圆距离单调对应，
+     * 预先算好每个 feature 的单位向量后，半径判断只需要几次乘加
+     *
+     */
+    struct UnitVector
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    UnitVector ToUnitVector(int32_t lat, int32_t lon);
+
+    /**
+     * @brief 两个单位向量之间弦长的平方
+     *
+     */
+    inline float ChordDistanceSquared(const UnitVector &a, const UnitVector &b)
+    {
+        float dx = a.x - b.x;
+        float dy = a.y - b.y;
+        float dz = a.z - b.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    /**
+     * @brief 大圆距离 radius 对应的弦长平方，ChordDistanceSquared 不大于该值即在半径内
+     *
+     */
+    float RadiusToChordSquared(double radius);
+
+    /**
+     * @brief 判断点是否在以 (lat, lon) 为圆心、radius 米为半径的圆内。
+     * 先比较 float 单位向量的弦长平方，明确在边界内外的点直接得出结果；落在 float 误差范围内的点
+     * （半径只有几米时即全部点）再用 double 计算夹角，边界上的点不会因为 float 精度误判
+     *
+     */
+    class RadiusFilter
+    {
+    public:
+        RadiusFilter(int32_t lat, int32_t lon, double radius);
+
+        /**
+         * @param unit_vector 该点的单位向量，即 ToUnitVector(lat, lon) 的结果
+         */
+        bool Contains(int32_t lat, int32_t lon, const UnitVector &unit_vector) const;
+
+    private:
+        int32_t lat_;
+        int32_t lon_;
+        UnitVector center_;
+        double angle_;        // 半径对应的圆心角
+        float inner_squared_; // 弦长平方小于该值时一定在圆内
+        float outer_squared_; // 弦长平方大于该值时一定在圆外
+    };
+
+    /**
+     * @brief 计算以 (lat, lon) 为圆心、radius 米为半径的圆的经纬度包围盒。
+     * 跨越 ±180 度经线时拆分为两个包围盒，覆盖极点时经度取全范围
+     *
+     * @param boxes 输出包围盒（追加写入）
+     */
+    void GetRadiusBoundingBoxes(int32_t lat, int32_t lon, double radius, std::vector<BoundingBox> *boxes);
+
+    /**
+     * @brief 计算到大圆线段 (lat1, lon1)-(lat2, lon2) 的距离不超过 radius 米的区域的经纬度包围盒。
+     * 线段按不短于 2 * radius 的长度切分，每段用以中点为圆心、覆盖整段的圆的包围盒近似，
+     * 因此跨越 ±180 度经线或靠近极点时同样正确
+     *
+     * @param boxes 输出包围盒（追加写入），相邻包围盒之间可能重叠
+     */
+    void GetSegmentBoundingBoxes(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2, double radius,
+                                 std::vector<BoundingBox> *boxes);
+
+    /**
+     * @brief 计算位置 (lat, lon) 到大圆线段 (lat1, lon1)-(lat2, lon2) 的最短大圆距离，两个端点相同时即到该点的距离
+     *
+     * @return double 距离，单位米
+     */
+    double GetDistanceToSegment(int32_t lat, int32_t lon, int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+    /**
+     * @brief 计算位置的 geohash 键：经纬度各量化为 30 位，从经度开始逐位交错拼成 60 位整数（Z 序）。
+     * 键的高 5n 位即 n 个字符的 geohash，按键排序后同一 geohash 前缀的位置是连续的一段
+     *
+     */
+    uint64_t GetGeohashKey(int32_t lat, int32_t lon);
+
+    /**
+     * @brief 计算 geohash 前缀对应的键区间 [lo, hi)，前缀不区分大小写
+     *
+     * @return bool 前缀为空、超过 kGeohashMaxLength 个字符或含有非 geohash 字符时返回 false
+     */
+    bool GetGeohashRange(const std::string &prefix, uint64_t *lo, uint64_t *hi);
+
+    /**
+     * @brief 把 geohash 键的高 5 * length 位编码为 geohash 字符串
+     *
+     */
+    std::string EncodeGeohash(uint64_t key, size_t length);
+
+} // namespace routeguide
+
+#endif //_GEO_UTIL_H_
@@ -16,31 +16,980 @@
  *
  */
 
+#include "helper.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
 #include "userlog.h"
+#include "mapped_file.h"
+#include "db_snapshot.h"
+#include "feature_store.h"
+#include "thread_pool.h"
 
 #include "route_guide.grpc.pb.h"
 
 namespace routeguide
 {
+  namespace
+  {
+    // Reads the whole file into *content with a single allocation.
+    bool ReadFile(const std::string &path, std::string *content)
+    {
+      std::ifstream file(path, std::ios::in | std::ios::binary);
+      if (!file.is_open())
+      {
+        return false;
+      }
+      file.seekg(0, std::ios::end);
+      std::streamoff size = file.tellg();
+      file.seekg(0, std::ios::beg);
+      if (size < 0)
+      {
+        // Not seekable (e.g. a pipe), fall back to streaming.
+        std::stringstream db;
+        db << file.rdbuf();
+        *content = db.str();
+        return true;
+      }
+      content->resize(static_cast<size_t>(size));
+      file.read(&(*content)[0], size);
+      return file.gcount() == size;
+    }
+
+    bool IsSpace(char c)
+    {
+      return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    // Newline-delimited JSON starts with a feature object, the array format
+    // with '['.
+    bool IsNdjson(const char *data, size_t size)
+    {
+      const char *end = data + size;
+      while (data < end && IsSpace(*data))
+      {
+        data++;
+      }
+      return data < end && *data == '{';
+    }
+
+    bool KeyIs(const char *key, size_t size, const char *expected)
+    {
+      return size == std::strlen(expected) && std::memcmp(key, expected, size) == 0;
+    }
+
+    // Finds the closing quote of the string whose opening quote is at p.
+    // Returns nullptr if the string is not terminated.
+    const char *FindStringEnd(const char *p, const char *end)
+    {
+      const char *q = p + 1;
+      while (q < end)
+      {
+        q = static_cast<const char *>(std::memchr(q, '"', end - q));
+        if (q == nullptr)
+        {
+          return nullptr;
+        }
+        // The quote is escaped if it is preceded by an odd number of backslashes.
+        size_t backslashes = 0;
+        while (q - backslashes - 1 > p && *(q - backslashes - 1) == '\\')
+        {
+          backslashes++;
+        }
+        if (backslashes % 2 == 0)
+        {
+          return q;
+        }
+        q++;
+      }
+      return nullptr;
+    }
+
+    struct DbSize
+    {
+      size_t features;   // objects directly inside the top-level array
+      size_t name_bytes; // source bytes of all string values (not keys), an upper bound of the name bytes
+    };
+
+    // The counting pass: only tracks nesting and string boundaries so that
+    // the store can be reserved up front. Malformed input is left to DbParser.
+    // depth is the nesting depth of the features' container at data: 0 for a
+    // whole JSON array, 1 for NDJSON or a slice of the array body.
+    DbSize CountDb(const char *data, size_t size, int depth)
+    {
+      DbSize count = {0, 0};
+      const char *p = data;
+      const char *end = data + size;
+      while (p < end)
+      {
+        switch (*p)
+        {
+        case '"':
+        {
+          const char *q = FindStringEnd(p, end);
+          if (q == nullptr)
+          {
+            return count;
+          }
+          const char *next = q + 1;
+          while (next < end && IsSpace(*next))
+          {
+            next++;
+          }
+          if (next == end || *next != ':')
+          {
+            count.name_bytes += q - p - 1;
+          }
+          p = q + 1;
+          continue;
+        }
+        case '{':
+          count.features += depth == 1 ? 1 : 0;
+          depth++;
+          break;
+        case '[':
+          depth++;
+          break;
+        case '}':
+        case ']':
+          depth--;
+          break;
+        default:
+          break;
+        }
+        p++;
+      }
+      return count;
+    }
+
+    // A single-pass parser for the json db file, working in place on the
+    // file content. The db file is an array of features such as
+    // [{"location": {"latitude": 123, "longitude": 456}, "name": "..."}, ...]
+    // Keys may appear in any order, unknown keys are skipped, names may
+    // contain any JSON escape and "name" may be omitted for an empty name.
+    // Coordinates must be integers that fit in int32.
+    class DbParser
+    {
+    public:
+      DbParser(const char *data, size_t size) : begin_(data), p_(data), end_(data + size), error_("") {}
+
+      // Calls sink(latitude, longitude, name_data, name_size) for every
+      // feature in file order. name_data points either into the input or into
+      // a scratch buffer that is reused by the next feature. Returns false at
+      // the first malformed input, see error() and offset().
+      template <typename Sink>
+      bool Parse(Sink sink)
+      {
+        if (IsNdjson(p_, end_ - p_))
+        {
+          return ParseLines(sink);
+        }
+        if (!Consume('['))
+        {
+          return Fail("expected '['");
+        }
+        if (!Consume(']'))
+        {
+          do
+          {
+            if (!ParseOne(sink))
+            {
+              return false;
+            }
+          } while (Consume(','));
+          if (!Consume(']'))
+          {
+            return Fail("expected ',' or ']'");
+          }
+        }
+        SkipSpace();
+        return p_ == end_ || Fail("unexpected data after ']'");
+      }
+
+      // Newline-delimited JSON: one feature object per line, blank lines are
+      // allowed.
+      template <typename Sink>
+      bool ParseLines(Sink sink)
+      {
+        SkipSpace();
+        while (p_ < end_)
+        {
+          if (!ParseOne(sink))
+          {
+            return false;
+          }
+          while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r'))
+          {
+            p_++;
+          }
+          if (p_ < end_ && *p_ != '\n')
+          {
+            return Fail("expected a newline after the feature");
+          }
+          SkipSpace();
+        }
+        return true;
+      }
+
+      // Parses a slice of the array body that starts at a feature. Every
+      // feature must be followed by ',' up to the end of the slice, except
+      // that the last slice of the array ends with ']'.
+      template <typename Sink>
+      bool ParseArraySlice(Sink sink, bool last)
+      {
+        while (true)
+        {
+          if (!ParseOne(sink))
+          {
+            return false;
+          }
+          if (Consume(','))
+          {
+            SkipSpace();
+            if (!last && p_ == end_)
+            {
+              return true;
+            }
+            continue;
+          }
+          if (!last)
+          {
+            return Fail("expected ','");
+          }
+          if (!Consume(']'))
+          {
+            return Fail("expected ',' or ']'");
+          }
+          SkipSpace();
+          return p_ == end_ || Fail("unexpected data after ']'");
+        }
+      }
+
+      const char *error() const { return error_; }
+      size_t offset() const { return p_ - begin_; }
+
+    private:
+      // Nesting limit for skipped values.
+      static const int kMaxDepth = 64;
+
+      bool Fail(const char *error)
+      {
+        error_ = error;
+        return false;
+      }
+
+      void SkipSpace()
+      {
+        while (p_ < end_ && IsSpace(*p_))
+        {
+          p_++;
+        }
+      }
+
+      bool Consume(char c)
+      {
+        SkipSpace();
+        if (p_ < end_ && *p_ == c)
+        {
+          p_++;
+          return true;
+        }
+        return false;
+      }
+
+      template <typename Sink>
+      bool ParseOne(Sink &sink)
+      {
+        int32_t latitude = 0;
+        int32_t longitude = 0;
+        const char *name = nullptr;
+        size_t name_size = 0;
+        if (!ParseFeature(&latitude, &longitude, &name, &name_size))
+        {
+          return false;
+        }
+        sink(latitude, longitude, name, name_size);
+        return true;
+      }
+
+      bool ParseFeature(int32_t *latitude, int32_t *longitude, const char **name, size_t *name_size)
+      {
+        if (!Consume('{'))
+        {
+          return Fail("expected '{'");
+        }
+        bool has_location = false;
+        *name = p_;
+        *name_size = 0;
+        if (Consume('}'))
+        {
+          return Fail("missing \"location\"");
+        }
+        do
+        {
+          const char *key = nullptr;
+          size_t key_size = 0;
+          if (!ParseKey(&key, &key_size))
+          {
+            return false;
+          }
+          if (KeyIs(key, key_size, "location"))
+          {
+            if (!ParseLocation(latitude, longitude))
+            {
+              return false;
+            }
+            has_location = true;
+          }
+          else if (KeyIs(key, key_size, "name"))
+          {
+            if (!ParseString(name, name_size, &name_scratch_))
+            {
+              return false;
+            }
+          }
+          else if (!SkipValue(0))
+          {
+            return false;
+          }
+        } while (Consume(','));
+        if (!Consume('}'))
+        {
+          return Fail("expected ',' or '}'");
+        }
+        return has_location || Fail("missing \"location\"");
+      }
+
+      bool ParseLocation(int32_t *latitude, int32_t *longitude)
+      {
+        if (!Consume('{'))
+        {
+          return Fail("expected '{'");
+        }
+        bool has_latitude = false;
+        bool has_longitude = false;
+        if (!Consume('}'))
+        {
+          do
+          {
+            const char *key = nullptr;
+            size_t key_size = 0;
+            if (!ParseKey(&key, &key_size))
+            {
+              return false;
+            }
+            if (KeyIs(key, key_size, "latitude"))
+            {
+              if (!ParseInt32(latitude))
+              {
+                return false;
+              }
+              has_latitude = true;
+            }
+            else if (KeyIs(key, key_size, "longitude"))
+            {
+              if (!ParseInt32(longitude))
+              {
+                return false;
+              }
+              has_longitude = true;
+            }
+            else if (!SkipValue(0))
+            {
+              return false;
+            }
+          } while (Consume(','));
+          if (!Consume('}'))
+          {
+            return Fail("expected ',' or '}'");
+          }
+        }
+        return (has_latitude && has_longitude) || Fail("missing \"latitude\" or \"longitude\"");
+      }
+
+      bool ParseKey(const char **key, size_t *key_size)
+      {
+        if (!ParseString(key, key_size, &scratch_))
+        {
+          return false;
+        }
+        return Consume(':') || Fail("expected ':'");
+      }
+
+      // Parses a string value. Without escapes *data points into the input;
+      // otherwise the string is decoded into *scratch.
+      bool ParseString(const char **data, size_t *size, std::string *scratch)
+      {
+        if (!Consume('"'))
+        {
+          return Fail("expected string");
+        }
+        const char *start = p_;
+        while (p_ < end_ && *p_ != '"' && *p_ != '\\')
+        {
+          p_++;
+        }
+        if (p_ == end_)
+        {
+          return Fail("unterminated string");
+        }
+        if (*p_ == '"')
+        {
+          *data = start;
+          *size = p_ - start;
+          p_++;
+          return true;
+        }
+
+        scratch->assign(start, p_);
+        while (p_ < end_ && *p_ != '"')
+        {
+          if (*p_ != '\\')
+          {
+            scratch->push_back(*p_++);
+            continue;
+          }
+          if (++p_ == end_)
+          {
+            break;
+          }
+          char c = *p_++;
+          switch (c)
+          {
+          case '"':
+          case '\\':
+          case '/':
+            scratch->push_back(c);
+            break;
+          case 'b':
+            scratch->push_back('\b');
+            break;
+          case 'f':
+            scratch->push_back('\f');
+            break;
+          case 'n':
+            scratch->push_back('\n');
+            break;
+          case 'r':
+            scratch->push_back('\r');
+            break;
+          case 't':
+            scratch->push_back('\t');
+            break;
+          case 'u':
+            if (!ParseUnicodeEscape(scratch))
+            {
+              return false;
+            }
+            break;
+          default:
+            return Fail("invalid escape");
+          }
+        }
+        if (p_ == end_)
+        {
+          return Fail("unterminated string");
+        }
+        p_++;
+        *data = scratch->data();
+        *size = scratch->size();
+        return true;
+      }
+
+      bool ReadHex4(uint32_t *code)
+      {
+        if (end_ - p_ < 4)
+        {
+          return Fail("invalid \\u escape");
+        }
+        *code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+          char c = *p_++;
+          uint32_t digit = 0;
+          if (c >= '0' && c <= '9')
+          {
+            digit = c - '0';
+          }
+          else if (c >= 'a' && c <= 'f')
+          {
+            digit = c - 'a' + 10;
+          }
+          else if (c >= 'A' && c <= 'F')
+          {
+            digit = c - 'A' + 10;
+          }
+          else
+          {
+            return Fail("invalid \\u escape");
+          }
+          *code = *code << 4 | digit;
+        }
+        return true;
+      }
+
+      // Decodes the XXXX of \uXXXX (and a following low surrogate) as UTF-8.
+      bool ParseUnicodeEscape(std::string *scratch)
+      {
+        uint32_t code = 0;
+        if (!ReadHex4(&code))
+        {
+          return false;
+        }
+        if (code >= 0xD800 && code <= 0xDBFF)
+        {
+          uint32_t low = 0;
+          if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+          {
+            return Fail("unpaired surrogate");
+          }
+          p_ += 2;
+          if (!ReadHex4(&low))
+          {
+            return false;
+          }
+          if (low < 0xDC00 || low > 0xDFFF)
+          {
+            return Fail("unpaired surrogate");
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else if (code >= 0xDC00 && code <= 0xDFFF)
+        {
+          return Fail("unpaired surrogate");
+        }
+
+        if (code < 0x80)
+        {
+          scratch->push_back(static_cast<char>(code));
+        }
+        else if (code < 0x800)
+        {
+          scratch->push_back(static_cast<char>(0xC0 | (code >> 6)));
+          scratch->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+          scratch->push_back(static_cast<char>(0xE0 | (code >> 12)));
+          scratch->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          scratch->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+          scratch->push_back(static_cast<char>(0xF0 | (code >> 18)));
+          scratch->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+          scratch->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          scratch->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        return true;
+      }
+
+      bool ParseInt32(int32_t *value)
+      {
+        SkipSpace();
+        bool negative = p_ < end_ && *p_ == '-';
+        if (negative)
+        {
+          p_++;
+        }
+        if (p_ == end_ || *p_ < '0' || *p_ > '9')
+        {
+          return Fail("expected integer");
+        }
+        int64_t magnitude = 0;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9')
+        {
+          magnitude = magnitude * 10 + (*p_++ - '0');
+          if (magnitude > static_cast<int64_t>(INT32_MAX) + 1)
+          {
+            return Fail("integer out of range");
+          }
+        }
+        if (p_ < end_ && (*p_ == '.' || *p_ == 'e' || *p_ == 'E'))
+        {
+          return Fail("coordinates must be integers");
+        }
+        int64_t result = negative ? -magnitude : magnitude;
+        if (result > INT32_MAX)
+        {
+          return Fail("integer out of range");
+        }
+        *value = static_cast<int32_t>(result);
+        return true;
+      }
+
+      // Skips over any JSON value of an unknown key.
+      bool SkipValue(int depth)
+      {
+        if (depth > kMaxDepth)
+        {
+          return Fail("nesting too deep");
+        }
+        SkipSpace();
+        if (p_ == end_)
+        {
+          return Fail("unexpected end of file");
+        }
+        char c = *p_;
+        if (c == '"')
+        {
+          const char *data = nullptr;
+          size_t size = 0;
+          return ParseString(&data, &size, &scratch_);
+        }
+        if (c == '{' || c == '[')
+        {
+          char close = c == '{' ? '}' : ']';
+          p_++;
+          if (Consume(close))
+          {
+            return true;
+          }
+          do
+          {
+            if (c == '{')
+            {
+              const char *key = nullptr;
+              size_t key_size = 0;
+              if (!ParseKey(&key, &key_size))
+              {
+                return false;
+              }
+            }
+            if (!SkipValue(depth + 1))
+            {
+              return false;
+            }
+          } while (Consume(','));
+          return Consume(close) || Fail("unterminated object or array");
+        }
+        // Numbers, true, false and null.
+        const char *start = p_;
+        while (p_ < end_ && (std::isalnum(static_cast<unsigned char>(*p_)) || *p_ == '-' || *p_ == '+' || *p_ == '.'))
+        {
+          p_++;
+        }
+        return p_ != start || Fail("unexpected character");
+      }
+
+      const char *begin_;
+      const char *p_;
+      const char *end_;
+      const char *error_;
+      std::string scratch_;      // decoded keys and skipped strings with escapes
+      std::string name_scratch_; // decoded name with escapes, kept until the feature is complete
+    };
+
+    const int DbParser::kMaxDepth;
+
+    // Chunks smaller than this are not worth a thread of their own.
+    const size_t kMinChunkBytes = 1 << 20;
+
+    // Finds the start of the first feature of the array at or after p: a '{'
+    // preceded by ',' and '}' apart from whitespace. Strings and nesting are
+    // not tracked, so a "}, {" inside a name or an unknown nested value can
+    // yield a wrong split; ParseDbParallel detects that while parsing.
+    const char *FindArraySplit(const char *begin, const char *p, const char *end)
+    {
+      while ((p = static_cast<const char *>(std::memchr(p, ',', end - p))) != nullptr)
+      {
+        const char *prev = p;
+        while (prev > begin && IsSpace(prev[-1]))
+        {
+          prev--;
+        }
+        const char *next = ++p;
+        while (next < end && IsSpace(*next))
+        {
+          next++;
+        }
+        if (prev > begin && prev[-1] == '}' && next < end && *next == '{')
+        {
+          return next;
+        }
+      }
+      return end;
+    }
+
+    // NDJSON splits right after a newline, which never occurs inside a JSON
+    // string.
+    const char *FindLineSplit(const char *p, const char *end)
+    {
+      const char *q = static_cast<const char *>(std::memchr(p, '\n', end - p));
+      return q == nullptr ? end : q + 1;
+    }
+
+    size_t ResolveThreads(size_t threads)
+    {
+      return threads != 0 ? threads : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Splits [begin, end) into at most chunks pieces of similar size, each
+    // split moved forward to the next feature boundary. Returns the chunk
+    // bounds: chunk i is [bounds[i], bounds[i + 1]).
+    std::vector<const char *> SplitChunks(const char *begin, const char *end, size_t chunks, bool lines)
+    {
+      std::vector<const char *> bounds(1, begin);
+      size_t size = end - begin;
+      for (size_t i = 1; i < chunks; i++)
+      {
+        const char *guess = std::max(begin + size / chunks * i, bounds.back());
+        const char *split = lines ? FindLineSplit(guess, end) : FindArraySplit(begin, guess, end);
+        if (split > bounds.back() && split < end)
+        {
+          bounds.push_back(split);
+        }
+      }
+      bounds.push_back(end);
+      return bounds;
+    }
+
+    // Parses every chunk into its own store on pool and waits for all of
+    // them. Array chunks must end right before the next feature, except the
+    // last one, which ends with ']'. The first chunk starts at a real
+    // feature, and a chunk that parses cleanly ends exactly where the next
+    // feature starts, so guessed array splits are all correct iff every
+    // chunk parses. Returns whether they all did.
+    bool ParseChunks(const std::vector<const char *> &bounds, bool lines, ThreadPool *pool,
+                     std::vector<FeatureStore> *parts)
+    {
+      size_t chunks = bounds.size() - 1;
+      parts->clear();
+      parts->resize(chunks);
+      std::vector<char> ok(chunks, 0);
+      std::mutex mu;
+      std::condition_variable cv;
+      size_t pending = chunks;
+      for (size_t i = 0; i < chunks; i++)
+      {
+        pool->Submit([&bounds, parts, &ok, &mu, &cv, &pending, lines, chunks, i]() {
+          const char *begin = bounds[i];
+          size_t length = bounds[i + 1] - begin;
+          FeatureStore *part = &(*parts)[i];
+          DbSize count = CountDb(begin, length, 1);
+          part->Reserve(count.features, count.name_bytes);
+
+          DbParser parser(begin, length);
+          auto sink = [part](int32_t latitude, int32_t longitude, const char *name, size_t name_size) {
+            part->Add(latitude, longitude, name, name_size);
+          };
+          ok[i] = lines ? parser.ParseLines(sink) : parser.ParseArraySlice(sink, i + 1 == chunks);
+
+          // Notify while holding the lock: once pending drops to 0 the caller
+          // returns and the stack variables captured here are gone.
+          std::unique_lock<std::mutex> lock(mu);
+          if (--pending == 0)
+          {
+            cv.notify_one();
+          }
+        });
+      }
+      std::unique_lock<std::mutex> lock(mu);
+      cv.wait(lock, [&pending]() { return pending == 0; });
+      return std::find(ok.begin(), ok.end(), 0) == ok.end();
+    }
+
+    // Appends the parsed chunks to store in order, releasing each one as soon
+    // as it has been copied.
+    void AppendChunks(std::vector<FeatureStore> *parts, FeatureStore *store)
+    {
+      for (FeatureStore &part : *parts)
+      {
+        store->Append(part);
+        part = FeatureStore();
+      }
+      parts->clear();
+    }
+
+    // NDJSON is read in blocks of this size. Only complete lines are parsed,
+    // the partial last line is carried over to the next block.
+    const size_t kStreamBlockBytes = 16 << 20;
+
+    // Reads until buffer is full or the file ends. Returns the number of bytes
+    // read, or -1 with errno set.
+    ssize_t ReadFull(int fd, char *buffer, size_t size)
+    {
+      size_t done = 0;
+      while (done < size)
+      {
+        ssize_t n = read(fd, buffer + done, size - done);
+        if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        if (n < 0)
+        {
+          return -1;
+        }
+        if (n == 0)
+        {
+          break;
+        }
+        done += n;
+      }
+      return static_cast<ssize_t>(done);
+    }
+
+    // Streams an NDJSON file block by block, so memory use is bounded by the
+    // block and the store regardless of the file size. Large blocks are split
+    // at newlines and parsed in parallel like ParseDbParallel. Returns false
+    // on a read error; malformed input leaves the store empty.
+    bool StreamNdjson(int fd, size_t threads, FeatureStore *store)
+    {
+      threads = ResolveThreads(threads);
+      std::unique_ptr<ThreadPool> pool;
+      if (threads > 1)
+      {
+        pool.reset(new ThreadPool(threads));
+      }
+      std::vector<char> buffer(kStreamBlockBytes);
+      std::vector<FeatureStore> parts;
+      size_t filled = 0;
+      uint64_t offset = 0; // file offset of buffer[0]
+      bool eof = false;
+      while (!eof)
+      {
+        if (filled == buffer.size())
+        {
+          // A single line longer than the whole buffer.
+          buffer.resize(buffer.size() * 2);
+        }
+        ssize_t n = ReadFull(fd, buffer.data() + filled, buffer.size() - filled);
+        if (n < 0)
+        {
+          return false;
+        }
+        eof = static_cast<size_t>(n) < buffer.size() - filled;
+        filled += n;
+
+        const char *begin = buffer.data();
+        const char *end = begin + filled;
+        if (!eof)
+        {
+          while (end > begin && end[-1] != '\n')
+          {
+            end--;
+          }
+        }
+        size_t size = end - begin;
+        size_t chunks = pool ? std::min(threads, size / kMinChunkBytes) : 1;
+        bool ok = false;
+        if (chunks > 1)
+        {
+          ok = ParseChunks(SplitChunks(begin, end, chunks, true), true, pool.get(), &parts);
+          if (ok)
+          {
+            AppendChunks(&parts, store);
+          }
+        }
+        else
+        {
+          DbParser parser(begin, size);
+          ok = parser.ParseLines([store](int32_t latitude, int32_t longitude, const char *name, size_t name_size) {
+            store->Add(latitude, longitude, name, name_size);
+          });
+        }
+        if (!ok)
+        {
+          // Parse the block again on this thread to locate the error.
+          DbParser parser(begin, size);
+          parser.ParseLines([](int32_t, int32_t, const char *, size_t) {});
+          SPDLOG_ERROR("Error parsing the db file at byte {:d}: {}", offset + parser.offset(), parser.error());
+          store->Clear();
+          return true;
+        }
+
+        std::memmove(buffer.data(), end, filled - size);
+        filled -= size;
+        offset += size;
+      }
+      return true;
+    }
+
+    // Streams varint length-prefixed Feature messages. Each message gets its
+    // own CodedInputStream inside ParseDelimitedFromZeroCopyStream, so files
+    // larger than the 2 GB limit of a single coded stream are fine. Returns
+    // false on a read error; a malformed message leaves the store empty.
+    bool StreamProtobuf(int fd, FeatureStore *store)
+    {
+      google::protobuf::io::FileInputStream input(fd, 1 << 20);
+      Feature feature;
+      bool clean_eof = false;
+      while (true)
+      {
+        // Parsing merges into the message, fields absent from this message
+        // must not keep the values of the previous one.
+        feature.Clear();
+        if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&feature, &input, &clean_eof))
+        {
+          break;
+        }
+        store->Add(feature.location().latitude(), feature.location().longitude(), feature.name());
+      }
+      if (input.GetErrno() != 0)
+      {
+        errno = input.GetErrno();
+        return false;
+      }
+      if (!clean_eof)
+      {
+        SPDLOG_ERROR("Error parsing the db file at message {:d}: truncated or malformed Feature", store->size());
+        store->Clear();
+      }
+      return true;
+    }
+
+    bool EndsWith(const std::string &s, const char *suffix)
+    {
+      size_t size = std::strlen(suffix);
+      return s.size() > size && s.compare(s.size() - size, size, suffix) == 0;
+    }
+
+    // A length-delimited Feature starts with a varint length followed by the
+    // tag of field 1 (name) or 2 (location), both length-delimited.
+    bool LooksLikeDelimitedFeature(const unsigned char *head, size_t size)
+    {
+      uint64_t length = 0;
+      for (size_t i = 0; i < size && i < 5; i++)
+      {
+        length |= static_cast<uint64_t>(head[i] & 0x7F) << (7 * i);
+        if ((head[i] & 0x80) == 0)
+        {
+          return length > 0 && i + 1 < size && (head[i + 1] == 0x0A || head[i + 1] == 0x12);
+        }
+      }
+      return false;
+    }
+  } // namespace
+
   std::string GetDbFileContent(const std::string &db_path)
   {
-    std::ifstream db_file(db_path);
-    if (!db_file.is_open())
+    std::string db;
+    if (!ReadFile(db_path, &db))
     {
       std::cout << "Failed to open " << db_path << std::endl;
       return "";
     }
-    std::stringstream db;
-    db << db_file.rdbuf();
-    return db.str();
+    return db;
   }
 
   std::string GetDbFileContent(int argc, char **argv)
@@ -68,138 +1017,209 @@ namespace routeguide
       db_path = "route_guide_db.json";
 #endif
     }
-    std::ifstream db_file(db_path);
-    if (!db_file.is_open())
+    std::string db;
+    if (!ReadFile(db_path, &db))
     {
       //std::cout << "Failed to open " << db_path << std::endl;
       SPDLOG_ERROR("Failed to open {}", db_path);
       return "";
     }
-    std::stringstream db;
-    db << db_file.rdbuf();
-    return db.str();
+    return db;
   }
 
-  // A simple parser for the json db file. It requires the db file to have the
-  // exact form of [{"location": { "latitude": 123, "longitude": 456}, "name":
-  // "the name can be empty" }, { ... } ... The spaces will be stripped.
-  class Parser
+  void ParseDb(const char *data, size_t size, std::vector<Feature> *feature_list)
   {
-  public:
-    explicit Parser(const std::string &db) : db_(db)
+    feature_list->clear();
+    feature_list->reserve(CountDb(data, size, IsNdjson(data, size) ? 1 : 0).features);
+
+    DbParser parser(data, size);
+    bool ok = parser.Parse([feature_list](int32_t latitude, int32_t longitude, const char *name, size_t name_size) {
+      feature_list->push_back(Feature());
+      Feature &feature = feature_list->back();
+      feature.mutable_location()->set_latitude(latitude);
+      feature.mutable_location()->set_longitude(longitude);
+      feature.set_name(name, name_size);
+    });
+    if (!ok)
     {
-      // Remove all spaces.
-      db_.erase(std::remove_if(db_.begin(), db_.end(), isspace), db_.end());
-      if (!Match("["))
-      {
-        SetFailedAndReturnFalse();
-      }
+      //std::cout << "Error parsing the db file";
+      SPDLOG_ERROR("Error parsing the db file at byte {:d}: {}", parser.offset(), parser.error());
+      feature_list->clear();
     }
+    //std::cout << "DB parsed, loaded " << feature_list->size() << " features."
+    //          << std::endl;
+    SPDLOG_INFO("DB parsed, loaded {:d} features.", feature_list->size());
+  }
 
-    bool Finished() { return current_ >= db_.size(); }
+  void ParseDb(const char *data, size_t size, FeatureStore *store)
+  {
+    store->Clear();
+    DbSize count = CountDb(data, size, IsNdjson(data, size) ? 1 : 0);
+    store->Reserve(count.features, count.name_bytes);
 
-    bool TryParseOne(Feature *feature)
+    DbParser parser(data, size);
+    bool ok = parser.Parse([store](int32_t latitude, int32_t longitude, const char *name, size_t name_size) {
+      store->Add(latitude, longitude, name, name_size);
+    });
+    if (!ok)
     {
-      if (failed_ || Finished() || !Match("{"))
-      {
-        return SetFailedAndReturnFalse();
-      }
-      if (!Match(location_) || !Match("{") || !Match(latitude_))
-      {
-        return SetFailedAndReturnFalse();
-      }
-      long temp = 0;
-      ReadLong(&temp);
-      feature->mutable_location()->set_latitude(temp);
-      if (!Match(",") || !Match(longitude_))
-      {
-        return SetFailedAndReturnFalse();
-      }
-      ReadLong(&temp);
-      feature->mutable_location()->set_longitude(temp);
-      if (!Match("},") || !Match(name_) || !Match("\""))
-      {
-        return SetFailedAndReturnFalse();
-      }
-      size_t name_start = current_;
-      while (current_ != db_.size() && db_[current_++] != '"')
-      {
-      }
-      if (current_ == db_.size())
-      {
-        return SetFailedAndReturnFalse();
-      }
-      feature->set_name(db_.substr(name_start, current_ - name_start - 1));
-      if (!Match("},"))
-      {
-        if (db_[current_ - 1] == ']' && current_ == db_.size())
-        {
-          return true;
-        }
-        return SetFailedAndReturnFalse();
-      }
-      return true;
+      SPDLOG_ERROR("Error parsing the db file at byte {:d}: {}", parser.offset(), parser.error());
+      store->Clear();
     }
+    store->ShrinkToFit();
+    SPDLOG_INFO("DB parsed, loaded {:d} features, {:d} bytes.", store->size(),
+                store->MemoryUsage());
+  }
 
-  private:
-    bool SetFailedAndReturnFalse()
+  void ParseDbParallel(const char *data, size_t size, size_t threads, FeatureStore *store)
+  {
+    threads = ResolveThreads(threads);
+    const char *end = data + size;
+    const char *body = data;
+    while (body < end && IsSpace(*body))
     {
-      failed_ = true;
-      return false;
+      body++;
+    }
+    bool lines = body < end && *body == '{';
+    size_t chunks = std::min(threads, size / kMinChunkBytes);
+    if (chunks <= 1 || (!lines && (body == end || *body != '[')))
+    {
+      ParseDb(data, size, store);
+      return;
     }
 
-    bool Match(const std::string &prefix)
+    std::vector<const char *> bounds = SplitChunks(lines ? body : body + 1, end, chunks, lines);
+    chunks = bounds.size() - 1;
+    if (chunks <= 1)
     {
-      bool eq = db_.substr(current_, prefix.size()) == prefix;
-      current_ += prefix.size();
-      return eq;
+      ParseDb(data, size, store);
+      return;
     }
 
-    void ReadLong(long *l)
+    // A guessed array split may be wrong, see FindArraySplit. Parsing again
+    // on one thread also reports the exact position of a real syntax error.
+    std::vector<FeatureStore> parts;
+    bool ok = false;
     {
-      size_t start = current_;
-      while (current_ != db_.size() && db_[current_] != ',' &&
-             db_[current_] != '}')
-      {
-        current_++;
-      }
-      // It will throw an exception if fails.
-      *l = std::stol(db_.substr(start, current_ - start));
+      ThreadPool pool(std::min(threads, chunks));
+      ok = ParseChunks(bounds, lines, &pool, &parts);
+    }
+    if (!ok)
+    {
+      SPDLOG_WARN("Failed to parse the db file in {:d} chunks, parsing it again on one thread", chunks);
+      parts.clear();
+      ParseDb(data, size, store);
+      return;
     }
 
-    bool failed_ = false;
-    std::string db_;
-    size_t current_ = 0;
-    const std::string location_ = "\"location\":";
-    const std::string latitude_ = "\"latitude\":";
-    const std::string longitude_ = "\"longitude\":";
-    const std::string name_ = "\"name\":";
-  };
+    size_t features = 0;
+    size_t name_bytes = 0;
+    for (const FeatureStore &part : parts)
+    {
+      features += part.size();
+      name_bytes += part.name_bytes();
+    }
+    store->Clear();
+    store->Reserve(features, name_bytes);
+    AppendChunks(&parts, store);
+    SPDLOG_INFO("DB parsed in {:d} chunks, loaded {:d} features, {:d} bytes.", chunks, store->size(),
+                store->MemoryUsage());
+  }
 
   void ParseDb(const std::string &db, std::vector<Feature> *feature_list)
   {
-    feature_list->clear();
-    std::string db_content(db);
-    db_content.erase(
-        std::remove_if(db_content.begin(), db_content.end(), isspace),
-        db_content.end());
+    ParseDb(db.data(), db.size(), feature_list);
+  }
+
+  void ParseDb(const std::string &db, FeatureStore *store)
+  {
+    ParseDb(db.data(), db.size(), store);
+  }
 
-    Parser parser(db_content);
-    Feature feature;
-    while (!parser.Finished())
+  DbFormat DetectDbFormat(const std::string &db_path)
+  {
+    if (EndsWith(db_path, ".json"))
     {
-      feature_list->push_back(Feature());
-      if (!parser.TryParseOne(&feature_list->back()))
+      return kDbJson;
+    }
+    if (EndsWith(db_path, ".ndjson") || EndsWith(db_path, ".jsonl"))
+    {
+      return kDbNdjson;
+    }
+    if (EndsWith(db_path, ".pb"))
+    {
+      return kDbProtobuf;
+    }
+    if (IsSnapshotPath(db_path))
+    {
+      return kDbSnapshot;
+    }
+
+    // Unknown extension: look at the first bytes. A file that cannot be read
+    // is reported as JSON and fails when it is opened.
+    unsigned char head[16];
+    std::ifstream file(db_path, std::ios::in | std::ios::binary);
+    file.read(reinterpret_cast<char *>(head), sizeof(head));
+    size_t size = static_cast<size_t>(file.gcount());
+    if (size >= sizeof(kSnapshotMagic) && std::memcmp(head, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0)
+    {
+      return kDbSnapshot;
+    }
+    size_t i = 0;
+    while (i < size && IsSpace(static_cast<char>(head[i])))
+    {
+      i++;
+    }
+    if (i < size && head[i] == '{')
+    {
+      return kDbNdjson;
+    }
+    if (i < size && head[i] != '[' && LooksLikeDelimitedFeature(head, size))
+    {
+      return kDbProtobuf;
+    }
+    return kDbJson;
+  }
+
+  bool LoadDbFile(const std::string &db_path, FeatureStore *store, size_t threads)
+  {
+    store->Clear();
+    DbFormat format = DetectDbFormat(db_path);
+    if (format == kDbNdjson || format == kDbProtobuf)
+    {
+      int fd = open(db_path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
       {
-        //std::cout << "Error parsing the db file";
-        SPDLOG_ERROR("Error parsing the db file");
-        feature_list->clear();
-        break;
+        SPDLOG_ERROR("Failed to open {}: {}", db_path, std::strerror(errno));
+        return false;
       }
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      bool ok = format == kDbNdjson ? StreamNdjson(fd, threads, store) : StreamProtobuf(fd, store);
+      int error = errno;
+      close(fd);
+      if (!ok)
+      {
+        SPDLOG_ERROR("Failed to read {}: {}", db_path, std::strerror(error));
+        store->Clear();
+        return false;
+      }
+      store->ShrinkToFit();
+      SPDLOG_INFO("DB streamed as {}, loaded {:d} features, {:d} bytes.",
+                  format == kDbNdjson ? "NDJSON" : "protobuf", store->size(), store->MemoryUsage());
+      return true;
     }
-    //std::cout << "DB parsed, loaded " << feature_list->size() << " features."
-    //          << std::endl;
-    SPDLOG_INFO("DB parsed, loaded {:d} features.", feature_list->size());
+
+    MappedFile file;
+    if (!file.Open(db_path))
+    {
+      SPDLOG_ERROR("Failed to open {}: {}", db_path, std::strerror(errno));
+      return false;
+    }
+    ParseDbParallel(file.data(), file.size(), threads, store);
+    // The store owns copies of every name, so the mapping can go before the
+    // caller starts building indexes on top of it.
+    file.Close();
+    return true;
   }
 
 } // namespace routeguide
@@ -19,17 +19,64 @@
 #ifndef GRPC_COMMON_CPP_ROUTE_GUIDE_HELPER_H_
 #define GRPC_COMMON_CPP_ROUTE_GUIDE_HELPER_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace routeguide
 {
     class Feature;
+    class FeatureStore;
 
     std::string GetDbFileContent(int argc, char **argv);
     std::string GetDbFileContent(const std::string &db_path);
 
+    /**
+     * @brief 单遍解析 JSON 数据库内容，直接在输入上解析，不复制整个文件。
+     * 支持 JSON 数组和每行一个 feature 的 NDJSON 两种格式，按第一个非空白字符区分；
+     * 键的顺序不限，未知的键被跳过，名称支持全部 JSON 转义；解析失败时输出为空
+     *
+     */
+    void ParseDb(const char *data, size_t size, std::vector<Feature> *feature_list);
+    void ParseDb(const char *data, size_t size, FeatureStore *store);
     void ParseDb(const std::string &db, std::vector<Feature> *feature_list);
+    void ParseDb(const std::string &db, FeatureStore *store);
+
+    /**
+     * @brief 并行解析数据库内容：在 feature 边界把输入切成若干块，在线程池中把每块解析到独立的列式存储，再按原顺序合并。
+     * 输入小于切分的最小块或切分点被确认无效（如名称中含有 "}, {"）时退回单线程解析，结果与 ParseDb 完全相同
+     *
+     * @param threads 解析线程数，0 表示使用 CPU 核数，1 表示单线程解析
+     */
+    void ParseDbParallel(const char *data, size_t size, size_t threads, FeatureStore *store);
+
+    /**
+     * @brief 数据库文件格式
+     *
+     */
+    enum DbFormat
+    {
+        kDbJson,     // JSON 数组(.json)，内存映射后解析
+        kDbNdjson,   // 每行一个 feature 的 JSON(.ndjson/.jsonl)，分块流式读取
+        kDbProtobuf, // varint 长度前缀分隔的 Feature 消息流(.pb)，流式读取
+        kDbSnapshot, // 二进制快照(.rgsnap)，由 FeatureDb::OpenSnapshot 打开
+    };
+
+    /**
+     * @brief 判断数据库文件格式：优先按扩展名，扩展名无法识别时读取文件开头的几个字节判断
+     *
+     */
+    DbFormat DetectDbFormat(const std::string &db_path);
+
+    /**
+     * @brief 读取数据库文件，格式由 DetectDbFormat 判断。
+     * JSON 数组以内存映射方式读取并直接在映射上解析，不把文件复制到堆上，解析完成即释放映射；
+     * NDJSON 和 protobuf 流按固定大小的块流式读取，内存占用只与 store 有关，与文件大小无关
+     *
+     * @param threads 解析线程数，0 表示使用 CPU 核数，1 表示单线程解析；protobuf 流总是单线程解析
+     * @return bool 文件能否打开和读取；内容解析失败时返回 true，store 为空
+     */
+    bool LoadDbFile(const std::string &db_path, FeatureStore *store, size_t threads = 0);
 
 } // namespace routeguide
 
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include "live_feature_db.h"
+#include "userlog.h"
+
+#include "route_guide.grpc.pb.h"
+
+namespace routeguide
+{
+    const size_t LiveFeatureDb::kMergeThreshold;
+    const size_t LiveFeatureDb::kMergeRatio;
+
+    namespace
+    {
+        bool Exists(const FeatureSnapshot &snapshot, int32_t latitude, int32_t longitude)
+        {
+            uint64_t key = PackPoint(latitude, longitude);
+            const DeltaEntry *entry = snapshot.delta().Find(key);
+            if (entry != nullptr)
+            {
+                return !entry->deleted;
+            }
+            return snapshot.base().point_index().Find(key) != PointIndex::kNotFound;
+        }
+    } // namespace
+
+    bool FeatureSnapshot::Lookup(const Point &point, Feature *feature) const
+    {
+        uint64_t key = PackPoint(point.latitude(), point.longitude());
+        const DeltaEntry *entry = delta_->Find(key);
+        if (entry != nullptr)
+        {
+            if (entry->deleted)
+            {
+                feature->mutable_location()->CopyFrom(point);
+                return false;
+            }
+            entry->ToFeature(feature);
+            return true;
+        }
+
+        // 大部分查询的位置上没有 feature，先用布隆过滤器排除，只访问一个缓存行
+        uint32_t row = base_->bloom_filter().MayContain(key) ? base_->point_index().Find(key) : PointIndex::kNotFound;
+        if (row == PointIndex::kNotFound)
+        {
+            feature->mutable_location()->CopyFrom(point);
+            return false;
+        }
+        base_->store().ToFeature(row, feature);
+        return true;
+    }
+
+    void FeatureSnapshot::ScatterQuery(const BoundingBox &box, ThreadPool *pool,
+                                       const std::function<void(const std::vector<uint32_t> &)> &consume) const
+    {
+        // 各分区的结果按完成顺序放入 done，调用线程等待所有分区完成后才返回，任务可以引用栈上的变量
+        std::mutex mu;
+        std::condition_variable cv;
+        std::deque<std::vector<uint32_t>> done;
+        size_t pending = 0;
+        for (const FeaturePartition &partition : base_->partitions())
+        {
+            if (!partition.bounds.Intersects(box))
+            {
+                continue;
+            }
+            pending++;
+            const FeaturePartition *p = &partition;
+            pool->Submit([this, &box, &mu, &cv, &done, p]() {
+                std::vector<uint32_t> rows;
+                p->index.Query(box, &rows);
+                size_t kept = 0;
+                for (uint32_t local : rows)
+                {
+                    uint32_t row = static_cast<uint32_t>(local + p->begin);
+                    if (!Hidden(row))
+                    {
+                        rows[kept++] = row;
+                    }
+                }
+                rows.resize(kept);
+
+                // 持有锁时通知，调用线程取到最后一个结果返回后，本任务不会再访问栈上的变量
+                std::unique_lock<std::mutex> lock(mu);
+                done.push_back(std::move(rows));
+                cv.notify_one();
+            });
+        }
+
+        for (; pending > 0; pending--)
+        {
+            std::vector<uint32_t> rows;
+            {
+                std::unique_lock<std::mutex> lock(mu);
+                cv.wait(lock, [&done]() { return !done.empty(); });
+                rows = std::move(done.front());
+                done.pop_front();
+            }
+            consume(rows);
+        }
+    }
+
+    LiveFeatureDb::LiveFeatureDb(const std::string &db_path, size_t load_threads)
+        : snapshot_(std::make_shared<const FeatureSnapshot>(LoadOrEmpty(db_path, load_threads),
+                                                            std::make_shared<const FeatureDelta>(), 1)),
+          load_threads_(load_threads), next_seq_(1), merge_requested_(false), stopping_(false),
+          merge_thread_(&LiveFeatureDb::MergeLoop, this)
+    {
+    }
+
+    LiveFeatureDb::~LiveFeatureDb()
+    {
+        {
+            std::unique_lock<std::mutex> lock(merge_mu_);
+            stopping_ = true;
+        }
+        merge_cv_.notify_one();
+        merge_thread_.join();
+    }
+
+    std::shared_ptr<const FeatureDb> LiveFeatureDb::LoadOrEmpty(const std::string &db_path, size_t load_threads)
+    {
+        std::shared_ptr<const FeatureDb> base = LoadFeatureDb(db_path, 1, load_threads);
+        if (!base)
+        {
+            base = std::make_shared<const FeatureDb>(FeatureStore(), 1);
+        }
+        return base;
+    }
+
+    bool LiveFeatureDb::Reload(const std::string &db_path)
+    {
+        std::shared_ptr<const FeatureSnapshot> current = Load();
+        std::shared_ptr<const FeatureDb> base;
+        try
+        {
+            base = LoadFeatureDb(db_path, current->base().version() + 1, load_threads_);
+        }
+        catch (const std::exception &e)
+        {
+            SPDLOG_ERROR("重新加载数据库失败: {}，继续使用版本 {:d}", e.what(), current->version());
+            return false;
+        }
+        if (!base || base->store().empty())
+        {
+            SPDLOG_ERROR("新数据库为空或加载失败，继续使用版本 {:d}", current->version());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(writer_mu_);
+        current = Load();
+        std::shared_ptr<const FeatureSnapshot> next = std::make_shared<const FeatureSnapshot>(
+            base, std::make_shared<const FeatureDelta>(), current->version() + 1);
+        snapshot_.Store(next);
+        SPDLOG_INFO("数据库已切换到版本 {:d}，共 {:d} 个 feature，丢弃未合并的修改 {:d} 条",
+                    next->version(), base->store().size(), current->delta().size());
+        return true;
+    }
+
+    uint64_t LiveFeatureDb::Upsert(int32_t latitude, int32_t longitude, const std::string &name, bool *existed)
+    {
+        std::lock_guard<std::mutex> lock(writer_mu_);
+        *existed = Exists(*Load(), latitude, longitude);
+
+        DeltaEntry entry;
+        entry.seq = next_seq_++;
+        entry.deleted = false;
+        entry.latitude = latitude;
+        entry.longitude = longitude;
+        entry.name = name;
+        Apply(entry);
+        return entry.seq;
+    }
+
+    uint64_t LiveFeatureDb::Delete(int32_t latitude, int32_t longitude, bool *existed)
+    {
+        std::lock_guard<std::mutex> lock(writer_mu_);
+        *existed = Exists(*Load(), latitude, longitude);
+        if (!*existed)
+        {
+            return 0;
+        }
+
+        DeltaEntry entry;
+        entry.seq = next_seq_++;
+        entry.deleted = true;
+        entry.latitude = latitude;
+        entry.longitude = longitude;
+        Apply(entry);
+        return entry.seq;
+    }
+
+    void LiveFeatureDb::Apply(const DeltaEntry &entry)
+    {
+        std::shared_ptr<const FeatureSnapshot> current = Load();
+        std::shared_ptr<const FeatureDelta> delta = current->delta().With(entry);
+        snapshot_.Store(std::make_shared<const FeatureSnapshot>(current->base_ptr(), delta, current->version() + 1));
+
+        if (delta->size() >= MergeThreshold(current->base()))
+        {
+            std::unique_lock<std::mutex> lock(merge_mu_);
+            merge_requested_ = true;
+            merge_cv_.notify_one();
+        }
+    }
+
+    size_t LiveFeatureDb::MergeThreshold(const FeatureDb &base)
+    {
+        return std::max(kMergeThreshold, base.store().size() / kMergeRatio);
+    }
+
+    void LiveFeatureDb::Merge()
+    {
+        std::shared_ptr<const FeatureSnapshot> snapshot = Load();
+        const FeatureStore &base = snapshot->base().store();
+        const FeatureDelta &delta = snapshot->delta();
+        if (delta.empty())
+        {
+            return;
+        }
+
+        // 1. 不持有写锁：复制主库中未被覆盖的行，再按修改顺序追加增量层中的新增和修改
+        FeatureStore store;
+        store.Reserve(base.size() + delta.size(), base.name_bytes());
+        for (uint32_t row = 0; row < base.size(); row++)
+        {
+            if (!snapshot->Hidden(row))
+            {
+                store.Add(base.latitude(row), base.longitude(row), base.name_data(row), base.name_size(row));
+            }
+        }
+        std::vector<const DeltaEntry *> upserts;
+        for (const FeatureDelta::EntryMap::value_type &item : delta.entries())
+        {
+            if (!item.second.deleted)
+            {
+                upserts.push_back(&item.second);
+            }
+        }
+        std::sort(upserts.begin(), upserts.end(),
+                  [](const DeltaEntry *a, const DeltaEntry *b) { return a->seq < b->seq; });
+        for (const DeltaEntry *entry : upserts)
+        {
+            store.Add(entry->latitude, entry->longitude, entry->name);
+        }
+        std::shared_ptr<const FeatureDb> merged =
+            std::make_shared<const FeatureDb>(std::move(store), snapshot->base().version() + 1);
+
+        // 2. 持有写锁：合并期间写入的记录保留在新的增量层中
+        std::lock_guard<std::mutex> lock(writer_mu_);
+        std::shared_ptr<const FeatureSnapshot> current = Load();
+        if (current->base_ptr() != snapshot->base_ptr())
+        {
+            SPDLOG_INFO("合并期间主库已被替换，放弃本次合并");
+            return;
+        }
+        std::shared_ptr<const FeatureDelta> remaining = current->delta().Since(delta.max_seq());
+        snapshot_.Store(std::make_shared<const FeatureSnapshot>(merged, remaining, current->version()));
+        SPDLOG_INFO("增量层已合并，合并 {:d} 条记录，主库共 {:d} 个 feature，剩余增量 {:d} 条",
+                    delta.size(), merged->store().size(), remaining->size());
+    }
+
+    void LiveFeatureDb::MergeLoop()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(merge_mu_);
+                merge_cv_.wait(lock, [this]() { return merge_requested_ || stopping_; });
+                if (stopping_)
+                {
+                    return;
+                }
+                merge_requested_ = false;
+            }
+            Merge();
+        }
+    }
+
+} // namespace routeguide
@@ -0,0 +1,185 @@
+/**
+ * @file live_feature_db.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 支持在线修改的 feature 数据库：只读主库 + 增量层，读取端无锁，后台合并
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _LIVE_FEATURE_DB_H_
+#define _LIVE_FEATURE_DB_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "feature_db.h"
+#include "feature_delta.h"
+#include "rcu_ptr.h"
+#include "thread_pool.h"
+
+namespace routeguide
+{
+    class Feature;
+    class Point;
+
+    /**
+     * @brief 某一时刻的完整数据库视图：主库 + 增量层，两者都是只读的。
+     * 主库中位置出现在增量层里的 feature 被增量层的记录覆盖（修改或删除）。
+     *
+     */
+    class FeatureSnapshot
+    {
+    public:
+        FeatureSnapshot(std::shared_ptr<const FeatureDb> base, std::shared_ptr<const FeatureDelta> delta,
+                        uint64_t version)
+            : base_(std::move(base)), delta_(std::move(delta)), version_(version)
+        {
+        }
+
+        /**
+         * @brief 数据版本号，每次修改或重新加载后递增，合并增量层不改变数据内容，版本号不变
+         *
+         */
+        uint64_t version() const { return version_; }
+        const FeatureDb &base() const { return *base_; }
+        const FeatureDelta &delta() const { return *delta_; }
+        const std::shared_ptr<const FeatureDb> &base_ptr() const { return base_; }
+
+        /**
+         * @brief 主库中的第 row 行是否已被增量层覆盖，被覆盖的行不能再返回给调用方
+         *
+         */
+        bool Hidden(uint32_t row) const
+        {
+            return !delta_->empty() &&
+                   delta_->Find(PackPoint(base_->store().latitude(row), base_->store().longitude(row))) != nullptr;
+        }
+
+        /**
+         * @brief 查找 point 位置的 feature，找不到时只填充位置，名称为空
+         *
+         * @return bool 是否找到
+         */
+        bool Lookup(const Point &point, Feature *feature) const;
+
+        /**
+         * @brief 把 box 的矩形查询分发到主库中与之相交的各个分区，在 pool 中并行执行。
+         * 调用线程按完成顺序依次取出各分区命中的行（已去掉被增量层覆盖的行）交给 consume，
+         * 所有分区都完成后返回。增量层中的记录不在结果中，由调用方另行处理
+         *
+         */
+        void ScatterQuery(const BoundingBox &box, ThreadPool *pool,
+                          const std::function<void(const std::vector<uint32_t> &)> &consume) const;
+
+    private:
+        std::shared_ptr<const FeatureDb> base_;
+        std::shared_ptr<const FeatureDelta> delta_;
+        uint64_t version_;
+    };
+
+    /**
+     * @brief 支持在线修改的 feature 数据库。
+     * 当前视图通过 RcuPtr 发布，读取端只做原子操作；所有写操作（修改、合并、重新加载）由 writer_mu_ 串行化，
+     * 每次写操作都生成新的增量层或主库再整体发布。增量层超过 MergeThreshold() 条记录时由后台线程
+     * 合并进主库：合并期间不持有写锁，新的修改照常写入增量层，合并完成后只保留合并开始之后的记录。
+     *
+     */
+    class LiveFeatureDb
+    {
+    public:
+        // 合并需要重建整个主库，代价与主库大小成正比，所以阈值随主库增大：
+        // 取 max(kMergeThreshold, 主库行数 / kMergeRatio)，平均每次修改分摊的合并代价为常数
+        static const size_t kMergeThreshold = 1024;
+        static const size_t kMergeRatio = 64;
+
+        /**
+         * @brief 加载数据库文件作为主库并启动后台合并线程，文件无法加载时主库为空
+         *
+         * @param db_path 数据库文件路径，JSON、NDJSON、protobuf 流或二进制快照(.rgsnap)
+         * @param load_threads 加载和重新加载时解析 JSON 的线程数，0 表示使用 CPU 核数
+         */
+        explicit LiveFeatureDb(const std::string &db_path, size_t load_threads = 0);
+        ~LiveFeatureDb();
+
+        LiveFeatureDb(const LiveFeatureDb &) = delete;
+        LiveFeatureDb &operator=(const LiveFeatureDb &) = delete;
+
+        /**
+         * @brief 获取当前视图，无锁。调用方在整个请求中使用同一个视图
+         *
+         */
+        std::shared_ptr<const FeatureSnapshot> Load() const { return snapshot_.Load(); }
+
+        /**
+         * @brief 重新加载数据库文件替换主库，尚未合并的修改一并丢弃
+         *
+         * @param db_path 数据库文件路径，JSON、NDJSON、protobuf 流或二进制快照(.rgsnap)
+         * @return bool 是否替换成功，新数据库为空或加载失败时保留当前数据
+         */
+        bool Reload(const std::string &db_path);
+
+        /**
+         * @brief 新增或修改某个位置的 feature
+         *
+         * @param existed 输出修改前该位置是否已有 feature
+         * @return uint64_t 修改序号
+         */
+        uint64_t Upsert(int32_t latitude, int32_t longitude, const std::string &name, bool *existed);
+
+        /**
+         * @brief 删除某个位置的 feature，该位置没有 feature 时不做任何修改
+         *
+         * @param existed 输出删除前该位置是否有 feature
+         * @return uint64_t 修改序号，没有修改时为 0
+         */
+        uint64_t Delete(int32_t latitude, int32_t longitude, bool *existed);
+
+        /**
+         * @brief 立即把当前增量层合并进主库，在调用线程中执行
+         *
+         */
+        void Merge();
+
+    private:
+        /**
+         * @brief 加载初始主库，失败时使用空库，保证服务可以启动
+         *
+         */
+        static std::shared_ptr<const FeatureDb> LoadOrEmpty(const std::string &db_path, size_t load_threads);
+
+        /**
+         * @brief 写入一条增量记录并发布新视图，调用方持有 writer_mu_
+         *
+         */
+        void Apply(const DeltaEntry &entry);
+
+        /**
+         * @brief 主库为 base 时触发后台合并的增量层大小
+         *
+         */
+        static size_t MergeThreshold(const FeatureDb &base);
+
+        void MergeLoop();
+
+        RcuPtr<FeatureSnapshot> snapshot_;
+        size_t load_threads_;
+
+        std::mutex writer_mu_; // 串行化所有写操作，读取端不使用
+        uint64_t next_seq_;
+
+        std::mutex merge_mu_;
+        std::condition_variable merge_cv_;
+        bool merge_requested_;
+        bool stopping_;
+        std::thread merge_thread_;
+    };
+
+} // namespace routeguide
+
+#endif //_LIVE_FEATURE_DB_H_
@@ -38,15 +38,20 @@ public:
       // Hijack all calls
       //hijack = true;
     }
-    if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_MESSAGE))
+    bool raw_stream = strcmp(info_->method(), "/routeguide.RouteGuide/ListFeatures") == 0;
+    if (raw_stream && methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_MESSAGE))
+    { // ListFeatures 发送的是预编码的 ByteBuffer，结果集可能很大，不再逐条反序列化输出 JSON，只累计条数和字节数，结束时输出一次
+      raw_messages_++;
+      raw_bytes_ += methods->GetSerializedSendMessage()->Length();
+    }
+    else if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_MESSAGE))
     { //服务端发送返回消息之前
       //std::cout << "---InterceptionHookPoints::PRE_SEND_MESSAGE---" << std::endl;
       SPDLOG_INFO("---InterceptionHookPoints::PRE_SEND_MESSAGE---");
 
-      const grpc::protobuf::Message *req_msg = nullptr;
+      const grpc::protobuf::Message *req_msg = static_cast<const grpc::protobuf::Message *>(methods->GetSendMessage());
       std::string req_msg_str;
 
-      req_msg = static_cast<const grpc::protobuf::Message *>(methods->GetSendMessage());
       if (req_msg == nullptr)
       { //某些场景下非序列化消息不可用，此时需要再取一次序列化的消息再做类型转换
         // 此分支一般不会进入，目前没遇到过，是否需要有待验证
@@ -55,7 +60,13 @@ public:
         auto *buffer = methods->GetSerializedSendMessage();
         auto copied_buffer = *buffer;
 
-        if (strcmp(info_->method(), "/routeguide.RouteGuide/GetFeature") == 0 || strcmp(info_->method(), "/routeguide.RouteGuide/ListFeatures") == 0)
+        if (strcmp(info_->method(), "/routeguide.RouteGuide/GetFeature") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/NearestFeatures") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/FeaturesWithinRadius") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/LookupStream") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/ListFeaturesInPolygon") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/FeaturesAlongRoute") == 0 ||
+            strcmp(info_->method(), "/routeguide.RouteGuide/ListFeaturesByGeohash") == 0)
         {
           req_msg_feature.Clear();
           GPR_ASSERT(
@@ -63,6 +74,48 @@ public:
                   .ok());
           req_msg = &req_msg_feature;
         }
+        else if (strcmp(info_->method(), "/routeguide.RouteGuide/GetFeatures") == 0 ||
+                 strcmp(info_->method(), "/routeguide.RouteGuide/SearchFeatures") == 0)
+        {
+          req_msg_feature_batch.Clear();
+          GPR_ASSERT(
+              grpc::SerializationTraits<routeguide::FeatureBatch>::Deserialize(&copied_buffer, &req_msg_feature_batch)
+                  .ok());
+          req_msg = &req_msg_feature_batch;
+        }
+        else if (strcmp(info_->method(), "/routeguide.RouteGuide/UpsertFeature") == 0 ||
+                 strcmp(info_->method(), "/routeguide.RouteGuide/DeleteFeature") == 0)
+        {
+          req_msg_mutation.Clear();
+          GPR_ASSERT(
+              grpc::SerializationTraits<routeguide::MutationResult>::Deserialize(&copied_buffer, &req_msg_mutation)
+                  .ok());
+          req_msg = &req_msg_mutation;
+        }
+        else if (strcmp(info_->method(), "/routeguide.RouteGuide/GetServerStats") == 0)
+        {
+          req_msg_stats.Clear();
+          GPR_ASSERT(
+              grpc::SerializationTraits<routeguide::ServerStats>::Deserialize(&copied_buffer, &req_msg_stats)
+                  .ok());
+          req_msg = &req_msg_stats;
+        }
+        else if (strcmp(info_->method(), "/routeguide.RouteGuide/CountFeatures") == 0)
+        {
+          req_msg_count.Clear();
+          GPR_ASSERT(
+              grpc::SerializationTraits<routeguide::Count>::Deserialize(&copied_buffer, &req_msg_count)
+                  .ok());
+          req_msg = &req_msg_count;
+        }
+        else if (strcmp(info_->method(), "/routeguide.RouteGuide/FeatureDensity") == 0)
+        {
+          req_msg_density.Clear();
+          GPR_ASSERT(
+              grpc::SerializationTraits<routeguide::DensityGrid>::Deserialize(&copied_buffer, &req_msg_density)
+                  .ok());
+          req_msg = &req_msg_density;
+        }
         else if (strcmp(info_->method(), "/routeguide.RouteGuide/RecordRoute") == 0)
         {
           req_msg_summary.Clear();
@@ -135,6 +188,11 @@ public:
       //std::cout << "---InterceptionHookPoints::PRE_SEND_STATUS---" << std::endl;
       SPDLOG_INFO("---InterceptionHookPoints::PRE_SEND_STATUS---");
 
+      if (raw_stream)
+      {
+        SPDLOG_INFO("RPC接口: {}, 共返回 {} 条预编码消息, {} 字节", info_->method(), raw_messages_, raw_bytes_);
+      }
+
       grpc::Status status = methods->GetSendStatus();
       std::string resp_msg = status.ok() ? "成功" : status.error_message();
 
@@ -160,7 +218,14 @@ public:
 
 private:
   grpc::experimental::ServerRpcInfo *info_;
+  size_t raw_messages_ = 0;
+  size_t raw_bytes_ = 0;
   routeguide::Feature req_msg_feature;
+  routeguide::FeatureBatch req_msg_feature_batch;
+  routeguide::MutationResult req_msg_mutation;
+  routeguide::ServerStats req_msg_stats;
+  routeguide::Count req_msg_count;
+  routeguide::DensityGrid req_msg_density;
   routeguide::RouteSummary req_msg_summary;
   routeguide::RouteNote req_msg_route;
 };
@@ -0,0 +1,254 @@
+/**
+ * @file lru_cache.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 分片 LRU 缓存：按键哈希分成多个分片，每个分片独立加锁，减少并发请求之间的锁竞争
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _LRU_CACHE_H_
+#define _LRU_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace routeguide
+{
+    /**
+     * @brief 缓存准入策略
+     *
+     */
+    enum CacheAdmission
+    {
+        kAdmitAlways = 0,    // 每次未命中都写入缓存
+        kAdmitSecondMiss = 1 // 同一个键第二次未命中时才写入，避免只访问一次的键把热点挤出缓存
+    };
+
+    /**
+     * @brief 缓存配置
+     *
+     */
+    struct CacheOptions
+    {
+        size_t capacity;          // 总容量，按 Put 时给出的 charge 累计，0 表示不启用缓存
+        size_t shards;            // 分片个数
+        CacheAdmission admission; // 准入策略
+
+        CacheOptions() : capacity(0), shards(16), admission(kAdmitAlways) {}
+    };
+
+    /**
+     * @brief 解析准入策略名称，可选值为 always 和 second_miss
+     *
+     * @return bool 名称是否合法
+     */
+    inline bool ParseCacheAdmission(const std::string &name, CacheAdmission *admission)
+    {
+        if (name == "always")
+        {
+            *admission = kAdmitAlways;
+            return true;
+        }
+        if (name == "second_miss")
+        {
+            *admission = kAdmitSecondMiss;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 分片 LRU 缓存。每个分片的容量为总容量 / 分片个数，超出时淘汰最久未使用的条目。
+     * Value 一般为 std::shared_ptr<const T>，取出后在锁外使用，淘汰不影响正在使用的调用方。
+     *
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class ShardedLruCache
+    {
+    public:
+        explicit ShardedLruCache(const CacheOptions &options)
+            : options_(options), shards_(options.shards > 0 ? options.shards : 1)
+        {
+            for (Shard &shard : shards_)
+            {
+                shard.capacity = options_.capacity / shards_.size();
+            }
+        }
+
+        bool enabled() const { return options_.capacity > 0; }
+
+        /**
+         * @brief 查找并把条目移到最近使用的位置
+         *
+         * @return bool 是否命中
+         */
+        bool Get(const Key &key, Value *value)
+        {
+            Shard &shard = GetShard(key);
+            std::lock_guard<std::mutex> lock(shard.mu);
+            typename IndexMap::iterator it = shard.index.find(key);
+            if (it == shard.index.end())
+            {
+                shard.misses++;
+                return false;
+            }
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            *value = it->second->value;
+            shard.hits++;
+            return true;
+        }
+
+        /**
+         * @brief 写入条目，按准入策略可能不写入；charge 超过分片容量的条目不缓存
+         *
+         * @param charge 条目占用的容量
+         */
+        void Put(const Key &key, const Value &value, size_t charge)
+        {
+            Shard &shard = GetShard(key);
+            std::lock_guard<std::mutex> lock(shard.mu);
+            if (charge > shard.capacity)
+            {
+                return;
+            }
+            if (options_.admission == kAdmitSecondMiss && !Admit(&shard, key))
+            {
+                return;
+            }
+
+            typename IndexMap::iterator it = shard.index.find(key);
+            if (it != shard.index.end())
+            {
+                shard.usage -= it->second->charge;
+                shard.lru.erase(it->second);
+                shard.index.erase(it);
+            }
+            Entry entry = {key, value, charge};
+            shard.lru.push_front(entry);
+            shard.index[key] = shard.lru.begin();
+            shard.usage += charge;
+
+            while (shard.usage > shard.capacity)
+            {
+                shard.usage -= shard.lru.back().charge;
+                shard.index.erase(shard.lru.back().key);
+                shard.lru.pop_back();
+            }
+        }
+
+        /**
+         * @brief 清空所有条目，命中统计保留
+         *
+         */
+        void Clear()
+        {
+            for (Shard &shard : shards_)
+            {
+                std::lock_guard<std::mutex> lock(shard.mu);
+                shard.lru.clear();
+                shard.index.clear();
+                shard.seen.clear();
+                shard.usage = 0;
+            }
+        }
+
+        uint64_t hits() const { return Sum(&Shard::hits); }
+        uint64_t misses() const { return Sum(&Shard::misses); }
+        uint64_t entries() const { return Sum(&Shard::Entries); }
+
+    private:
+        struct Entry
+        {
+            Key key;
+            Value value;
+            size_t charge;
+        };
+
+        typedef std::list<Entry> EntryList;
+        typedef std::unordered_map<Key, typename EntryList::iterator, Hash> IndexMap;
+
+        struct Shard
+        {
+            mutable std::mutex mu;
+            EntryList lru; // 头部为最近使用
+            IndexMap index;
+            std::unordered_set<size_t> seen; // second_miss 策略下未命中过一次的键的哈希值
+            size_t capacity = 0;
+            size_t usage = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+
+            uint64_t Entries() const { return lru.size(); }
+        };
+
+        /**
+         * @brief second_miss 准入：第一次未命中只记录键的哈希值，第二次才允许写入
+         *
+         */
+        bool Admit(Shard *shard, const Key &key)
+        {
+            size_t hash = Hash()(key);
+            if (shard->seen.erase(hash) > 0)
+            {
+                return true;
+            }
+            // 记录数量有上限，超过后整体清空，相当于一个简单的时间窗口
+            if (shard->seen.size() >= kMaxSeenPerShard)
+            {
+                shard->seen.clear();
+            }
+            shard->seen.insert(hash);
+            return false;
+        }
+
+        Shard &GetShard(const Key &key)
+        {
+            // 再做一次乘法散列，避免键哈希的低位分布不均导致分片不均
+            uint64_t hash = static_cast<uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ULL;
+            return shards_[(hash >> 32) % shards_.size()];
+        }
+
+        uint64_t Sum(uint64_t Shard::*field) const
+        {
+            uint64_t total = 0;
+            for (const Shard &shard : shards_)
+            {
+                std::lock_guard<std::mutex> lock(shard.mu);
+                total += shard.*field;
+            }
+            return total;
+        }
+
+        uint64_t Sum(uint64_t (Shard::*method)() const) const
+        {
+            uint64_t total = 0;
+            for (const Shard &shard : shards_)
+            {
+                std::lock_guard<std::mutex> lock(shard.mu);
+                total += (shard.*method)();
+            }
+            return total;
+        }
+
+        static const size_t kMaxSeenPerShard = 4096;
+
+        CacheOptions options_;
+        std::vector<Shard> shards_;
+    };
+
+    template <typename Key, typename Value, typename Hash>
+    const size_t ShardedLruCache<Key, Value, Hash>::kMaxSeenPerShard;
+
+} // namespace routeguide
+
+#endif //_LRU_CACHE_H_
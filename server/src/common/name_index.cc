@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstring>
+
+#include "name_index.h"
+#include "db_snapshot.h"
+
+namespace routeguide
+{
+    const size_t NameIndex::kGramSize;
+
+    namespace
+    {
+        // 名称总字节数不超过该值时用排序 (片段, 行号) 对的方式构建倒排表，临时占用不超过 16MB，
+        // 远小于直接寻址计数数组的 64MB
+        const size_t kSortedPostingsBytes = 1 << 21;
+    } // namespace
+
+    std::string NameIndex::Fold(const char *data, size_t size)
+    {
+        std::string folded(data, size);
+        for (char &c : folded)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        return folded;
+    }
+
+    void NameIndex::Grams(const char *data, size_t size, std::vector<uint32_t> *grams)
+    {
+        grams->clear();
+        for (size_t i = 0; i + kGramSize <= size; i++)
+        {
+            grams->push_back(static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << 16 |
+                             static_cast<uint32_t>(static_cast<uint8_t>(data[i + 1])) << 8 |
+                             static_cast<uint32_t>(static_cast<uint8_t>(data[i + 2])));
+        }
+        std::sort(grams->begin(), grams->end());
+        grams->erase(std::unique(grams->begin(), grams->end()), grams->end());
+    }
+
+    void NameIndex::Build(const FeatureStore &store)
+    {
+        size_t n = store.size();
+
+        // 1. 小写名称
+        folded_.clear();
+        folded_.reserve(store.name_bytes());
+        folded_offset_.assign(1, 0);
+        folded_offset_.reserve(n + 1);
+        for (size_t row = 0; row < n; row++)
+        {
+            std::string folded = Fold(store.name_data(row), store.name_size(row));
+            folded_.append(folded.data(), folded.size());
+            folded_offset_.push_back(folded_.size());
+        }
+
+        // 2. 前缀索引：按小写名称排序
+        sorted_.clear();
+        for (uint32_t row = 0; row < n; row++)
+        {
+            if (folded_size(row) > 0)
+            {
+                sorted_.push_back(row);
+            }
+        }
+        std::sort(sorted_.mutable_data(), sorted_.mutable_data() + sorted_.size(), [this](uint32_t a, uint32_t b) {
+            size_t size_a = folded_size(a);
+            size_t size_b = folded_size(b);
+            int cmp = std::memcmp(folded_data(a), folded_data(b), std::min(size_a, size_b));
+            return cmp != 0 ? cmp < 0 : (size_a != size_b ? size_a < size_b : a < b);
+        });
+
+        // 3. 倒排表：片段个数不超过名称的字节数，据此选择构建方式
+        if (folded_.size() <= kSortedPostingsBytes)
+        {
+            BuildPostingsSorted(n);
+        }
+        else
+        {
+            BuildPostingsDense(n);
+        }
+        postings_.shrink_to_fit();
+        gram_keys_.shrink_to_fit();
+        gram_offset_.shrink_to_fit();
+    }
+
+    void NameIndex::BuildPostingsSorted(size_t n)
+    {
+        // 高 32 位为片段，低 32 位为行号，排序后同一片段的行号连续且升序
+        std::vector<uint64_t> pairs;
+        std::vector<uint32_t> grams;
+        for (uint32_t row = 0; row < n; row++)
+        {
+            Grams(folded_data(row), folded_size(row), &grams);
+            for (uint32_t gram : grams)
+            {
+                pairs.push_back(static_cast<uint64_t>(gram) << 32 | row);
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        gram_keys_.clear();
+        gram_offset_.assign(1, 0);
+        postings_.resize(pairs.size());
+        uint32_t *postings = postings_.mutable_data();
+        for (size_t i = 0; i < pairs.size(); i++)
+        {
+            uint32_t gram = static_cast<uint32_t>(pairs[i] >> 32);
+            if (gram_keys_.empty() || gram_keys_.back() != gram)
+            {
+                if (!gram_keys_.empty())
+                {
+                    gram_offset_.push_back(i);
+                }
+                gram_keys_.push_back(gram);
+            }
+            postings[i] = static_cast<uint32_t>(pairs[i]);
+        }
+        if (!gram_keys_.empty())
+        {
+            gram_offset_.push_back(pairs.size());
+        }
+    }
+
+    void NameIndex::BuildPostingsDense(size_t n)
+    {
+        // 先统计每个片段的行数，再按行号顺序填充。片段只有 2^24 种，
+        // 用直接寻址的计数数组代替哈希表，构建期间临时占用 64MB，只在名称数据较多时使用
+        std::vector<uint32_t> slot(1 << 24, 0);
+        std::vector<uint32_t> grams;
+        for (uint32_t row = 0; row < n; row++)
+        {
+            Grams(folded_data(row), folded_size(row), &grams);
+            for (uint32_t gram : grams)
+            {
+                slot[gram]++;
+            }
+        }
+        // 单个片段的行数不超过行数，用 uint32 计数即可；倒排表总长度可能超过 2^32，
+        // 填充位置放在按片段序号寻址的 64 位数组中，slot 之后改存片段序号
+        gram_keys_.clear();
+        gram_offset_.assign(1, 0);
+        for (uint32_t gram = 0; gram < slot.size(); gram++)
+        {
+            if (slot[gram] > 0)
+            {
+                gram_offset_.push_back(gram_offset_.back() + slot[gram]);
+                slot[gram] = static_cast<uint32_t>(gram_keys_.size());
+                gram_keys_.push_back(gram);
+            }
+        }
+        std::vector<uint64_t> cursor(gram_offset_.begin(), gram_offset_.end() - 1);
+
+        postings_.resize(gram_offset_.back());
+        uint32_t *postings = postings_.mutable_data();
+        for (uint32_t row = 0; row < n; row++)
+        {
+            Grams(folded_data(row), folded_size(row), &grams);
+            for (uint32_t gram : grams)
+            {
+                postings[cursor[slot[gram]]++] = row;
+            }
+        }
+    }
+
+    void NameIndex::FindPrefix(const std::string &query, size_t limit, const std::function<bool(uint32_t)> &accept,
+                               std::vector<uint32_t> *rows) const
+    {
+        std::string prefix = Fold(query.data(), query.size());
+        const uint32_t *it = std::lower_bound(
+            sorted_.begin(), sorted_.end(), prefix, [this](uint32_t row, const std::string &value) {
+                size_t size = folded_size(row);
+                int cmp = std::memcmp(folded_data(row), value.data(), std::min(size, value.size()));
+                return cmp != 0 ? cmp < 0 : size < value.size();
+            });
+
+        size_t found = 0;
+        for (; it != sorted_.end() && found < limit; ++it)
+        {
+            uint32_t row = *it;
+            if (folded_size(row) < prefix.size() || std::memcmp(folded_data(row), prefix.data(), prefix.size()) != 0)
+            {
+                break;
+            }
+            if (accept && !accept(row))
+            {
+                continue;
+            }
+            rows->push_back(row);
+            found++;
+        }
+    }
+
+    void NameIndex::FindSubstring(const std::string &query, size_t limit,
+                                  const std::function<bool(uint32_t)> &accept, std::vector<uint32_t> *rows) const
+    {
+        std::string needle = Fold(query.data(), query.size());
+        if (needle.size() < kGramSize || limit == 0)
+        {
+            return;
+        }
+
+        // 1. 取出每个片段的倒排表，按长度升序排列，最短的作为候选来源
+        std::vector<uint32_t> grams;
+        Grams(needle.data(), needle.size(), &grams);
+        std::vector<std::pair<const uint32_t *, const uint32_t *>> lists;
+        for (uint32_t gram : grams)
+        {
+            const uint32_t *key = std::lower_bound(gram_keys_.begin(), gram_keys_.end(), gram);
+            if (key == gram_keys_.end() || *key != gram)
+            {
+                return;
+            }
+            size_t i = key - gram_keys_.begin();
+            lists.push_back(std::make_pair(postings_.data() + gram_offset_[i], postings_.data() + gram_offset_[i + 1]));
+        }
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::pair<const uint32_t *, const uint32_t *> &a,
+                     const std::pair<const uint32_t *, const uint32_t *> &b) {
+                      return a.second - a.first < b.second - b.first;
+                  });
+
+        // 2. 遍历最短的倒排表，在其余倒排表中向前二分查找求交集，再确认子串确实存在
+        std::vector<const uint32_t *> cursor;
+        for (const std::pair<const uint32_t *, const uint32_t *> &list : lists)
+        {
+            cursor.push_back(list.first);
+        }
+        size_t found = 0;
+        for (const uint32_t *candidate = lists[0].first; candidate != lists[0].second && found < limit; candidate++)
+        {
+            uint32_t row = *candidate;
+            bool in_all = true;
+            for (size_t i = 1; i < lists.size() && in_all; i++)
+            {
+                cursor[i] = std::lower_bound(cursor[i], lists[i].second, row);
+                in_all = cursor[i] != lists[i].second && *cursor[i] == row;
+            }
+            if (!in_all)
+            {
+                continue;
+            }
+            const char *name = folded_data(row);
+            const char *name_end = name + folded_size(row);
+            if (std::search(name, name_end, needle.begin(), needle.end()) == name_end)
+            {
+                continue;
+            }
+            if (accept && !accept(row))
+            {
+                continue;
+            }
+            rows->push_back(row);
+            found++;
+        }
+    }
+
+    size_t NameIndex::MemoryUsage() const
+    {
+        return folded_.capacity() + (folded_offset_.capacity() + gram_offset_.capacity()) * sizeof(uint64_t) +
+               (sorted_.capacity() + gram_keys_.capacity() + postings_.capacity()) * sizeof(uint32_t);
+    }
+
+    void NameIndex::Save(SnapshotWriter *writer) const
+    {
+        writer->Write(kTagFoldedNames, folded_);
+        writer->Write(kTagFoldedOffset, folded_offset_);
+        writer->Write(kTagNameSorted, sorted_);
+        writer->Write(kTagGramKeys, gram_keys_);
+        writer->Write(kTagGramOffset, gram_offset_);
+        writer->Write(kTagPostings, postings_);
+    }
+
+    bool NameIndex::Load(SnapshotReader *reader, size_t rows)
+    {
+        if (!reader->Read(kTagFoldedNames, &folded_) || !reader->Read(kTagFoldedOffset, &folded_offset_) ||
+            !reader->Read(kTagNameSorted, &sorted_) || !reader->Read(kTagGramKeys, &gram_keys_) ||
+            !reader->Read(kTagGramOffset, &gram_offset_) || !reader->Read(kTagPostings, &postings_))
+        {
+            return false;
+        }
+        if (folded_offset_.size() != rows + 1 || folded_offset_.back() != folded_.size() || sorted_.size() > rows ||
+            gram_offset_.size() != gram_keys_.size() + 1 || gram_offset_.back() != postings_.size())
+        {
+            return reader->Fail("inconsistent name index");
+        }
+        // 偏移单调不减才能保证每一段都在数据区内；sorted_ 和倒排表中的行号会被直接用来取名称
+        if (folded_offset_[0] != 0 || !std::is_sorted(folded_offset_.begin(), folded_offset_.end()) ||
+            gram_offset_[0] != 0 || !std::is_sorted(gram_offset_.begin(), gram_offset_.end()))
+        {
+            return reader->Fail("bad name index offsets");
+        }
+        auto out_of_range = [rows](uint32_t row) { return row >= rows; };
+        if (std::find_if(sorted_.begin(), sorted_.end(), out_of_range) != sorted_.end() ||
+            std::find_if(postings_.begin(), postings_.end(), out_of_range) != postings_.end())
+        {
+            return reader->Fail("name index row out of range");
+        }
+        return true;
+    }
+
+} // namespace routeguide
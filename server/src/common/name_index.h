@@ -0,0 +1,114 @@
+/**
+ * @file name_index.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief feature 名称检索索引：按名称排序的前缀索引 + 三元组(trigram)倒排索引
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _NAME_INDEX_H_
+#define _NAME_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "feature_store.h"
+#include "flat_array.h"
+
+namespace routeguide
+{
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /**
+     * @brief 名称检索索引，匹配不区分 ASCII 大小写，名称为空的 feature 不参与检索。
+     * 前缀检索：所有名称转为小写后排序，二分查找到第一个不小于前缀的位置后顺序输出，结果按名称排序。
+     * 子串检索：每个名称的所有三字节片段建立倒排表（行号升序），查询时对查询串各片段的倒排表求交集，
+     * 再逐个确认候选名称确实包含查询串，结果按行号排序。查询串不足 3 个字节时只能做前缀检索。
+     * 构建后只读，可以被多个线程同时查询。
+     *
+     */
+    class NameIndex
+    {
+    public:
+        static const size_t kGramSize = 3;
+
+        /**
+         * @brief 根据 store 中的名称构建索引，会覆盖之前的内容
+         *
+         */
+        void Build(const FeatureStore &store);
+
+        /**
+         * @brief 查找名称以 query 开头的行，按名称顺序追加写入 rows
+         *
+         * @param query 查询串，不区分大小写
+         * @param limit 最多输出的行数
+         * @param accept 行号过滤条件，返回 false 的行被跳过且不计入 limit，为空时不过滤
+         * @param rows 输出行号（追加写入）
+         */
+        void FindPrefix(const std::string &query, size_t limit, const std::function<bool(uint32_t)> &accept,
+                        std::vector<uint32_t> *rows) const;
+
+        /**
+         * @brief 查找名称包含 query 的行，按行号顺序追加写入 rows。query 不足 kGramSize 个字节时不输出
+         *
+         * @param query 查询串，不区分大小写
+         * @param limit 最多输出的行数
+         * @param accept 行号过滤条件，返回 false 的行被跳过且不计入 limit，为空时不过滤
+         * @param rows 输出行号（追加写入）
+         */
+        void FindSubstring(const std::string &query, size_t limit, const std::function<bool(uint32_t)> &accept,
+                           std::vector<uint32_t> *rows) const;
+
+        /**
+         * @brief 转为小写（只处理 ASCII 字母，其余字节原样保留）
+         *
+         */
+        static std::string Fold(const char *data, size_t size);
+
+        size_t MemoryUsage() const;
+
+        /**
+         * @brief 写入快照 / 从快照读取，读出的数组直接引用快照文件的映射
+         *
+         * @param rows 从快照读取时 feature 的行数，用于检查数据是否一致
+         */
+        void Save(SnapshotWriter *writer) const;
+        bool Load(SnapshotReader *reader, size_t rows);
+
+    private:
+        const char *folded_data(uint32_t row) const { return folded_.data() + folded_offset_[row]; }
+        size_t folded_size(uint32_t row) const { return folded_offset_[row + 1] - folded_offset_[row]; }
+
+        /**
+         * @brief 名称中所有不重复的三字节片段，片段按字节拼成 24 位整数
+         *
+         */
+        static void Grams(const char *data, size_t size, std::vector<uint32_t> *grams);
+
+        /**
+         * @brief 由 folded_ 构建倒排表。片段总数较少时把 (片段, 行号) 对排序后分组，
+         * 较多时用 2^24 项的直接寻址计数数组做两遍扫描，避免保存全部 (片段, 行号) 对
+         *
+         */
+        void BuildPostingsSorted(size_t n);
+        void BuildPostingsDense(size_t n);
+
+        FlatArray<char> folded_;            // 所有名称的小写形式首尾相接存放，与 store 的行号一一对应
+        FlatArray<uint64_t> folded_offset_; // size()+1 个元素
+        FlatArray<uint32_t> sorted_;        // 名称非空的行，按小写名称排序
+
+        // 倒排表：gram_keys_ 升序，第 i 个片段的行号为 postings_[gram_offset_[i], gram_offset_[i + 1])
+        FlatArray<uint32_t> gram_keys_;
+        FlatArray<uint64_t> gram_offset_; // 倒排表总长度可能超过 2^32，与 folded_offset_ 一样用 64 位
+        FlatArray<uint32_t> postings_;
+    };
+
+} // namespace routeguide
+
+#endif //_NAME_INDEX_H_
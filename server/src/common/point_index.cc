@@ -0,0 +1,134 @@
+#include "point_index.h"
+#include "db_snapshot.h"
+
+namespace routeguide
+{
+    const uint32_t PointIndex::kNotFound;
+
+    uint64_t PointIndex::Hash(uint64_t key)
+    {
+        // splitmix64 的混淆函数，打散经纬度中相近的高位
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return key;
+    }
+
+    void PointIndex::Reserve(size_t n)
+    {
+        size_t capacity = 16;
+        while (capacity < n * 2)
+        {
+            capacity <<= 1;
+        }
+        if (capacity <= slots_.size())
+        {
+            return;
+        }
+
+        std::vector<Slot> old;
+        slots_.swap(old);
+        Slot empty = {0, kNotFound, 0};
+        slots_.assign(capacity, empty);
+        mask_ = capacity - 1;
+        size_ = 0;
+        for (const Slot &s : old)
+        {
+            if (s.row != kNotFound)
+            {
+                Insert(s.key, s.row);
+            }
+        }
+    }
+
+    void PointIndex::Grow()
+    {
+        Reserve(slots_.empty() ? 8 : slots_.size());
+    }
+
+    void PointIndex::Insert(uint64_t key, uint32_t row)
+    {
+        if ((size_ + 1) * 2 > slots_.size())
+        {
+            Grow();
+        }
+        size_t pos = Hash(key) & mask_;
+        while (slots_[pos].row != kNotFound)
+        {
+            if (slots_[pos].key == key)
+            {
+                return;
+            }
+            pos = (pos + 1) & mask_;
+        }
+        Slot *slot = slots_.mutable_data() + pos;
+        slot->key = key;
+        slot->row = row;
+        size_++;
+    }
+
+    uint32_t PointIndex::Find(uint64_t key) const
+    {
+        if (slots_.empty())
+        {
+            return kNotFound;
+        }
+        size_t pos = Hash(key) & mask_;
+        while (slots_[pos].row != kNotFound)
+        {
+            if (slots_[pos].key == key)
+            {
+                return slots_[pos].row;
+            }
+            pos = (pos + 1) & mask_;
+        }
+        return kNotFound;
+    }
+
+    void PointIndex::Save(SnapshotWriter *writer) const
+    {
+        uint64_t meta[] = {size_};
+        writer->Write(kTagPointMeta, meta, 1);
+        writer->Write(kTagPointSlots, slots_);
+    }
+
+    bool PointIndex::Load(SnapshotReader *reader, size_t rows)
+    {
+        const uint64_t *meta = nullptr;
+        size_t count = 0;
+        if (!reader->Read(kTagPointMeta, &meta, &count) || !reader->Read(kTagPointSlots, &slots_))
+        {
+            return false;
+        }
+        // 槽位数必须是 2 的幂（探测时用掩码取模），负载因子不超过 0.5（保证探测能遇到空槽）
+        if (count != 1 || (slots_.size() & (slots_.size() - 1)) != 0 || meta[0] * 2 > slots_.size())
+        {
+            return reader->Fail("inconsistent point index");
+        }
+        // 元数据只说明了负载因子，槽位内容还要逐个核对：行号越界会让调用方读越界，
+        // 占用槽数与 size 不符说明表已损坏，空槽数为 0 时 Find 查不到的键会一直探测下去
+        size_t used = 0;
+        for (const Slot &slot : slots_)
+        {
+            if (slot.row == kNotFound)
+            {
+                continue;
+            }
+            if (slot.row >= rows)
+            {
+                return reader->Fail("point index row out of range");
+            }
+            used++;
+        }
+        if (used != meta[0])
+        {
+            return reader->Fail("inconsistent point index");
+        }
+        size_ = meta[0];
+        mask_ = slots_.empty() ? 0 : slots_.size() - 1;
+        return true;
+    }
+
+} // namespace routeguide
@@ -0,0 +1,98 @@
+/**
+ * @file point_index.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 地理位置精确查找索引，按打包后的 64 位 (latitude, longitude) 做哈希
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _POINT_INDEX_H_
+#define _POINT_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flat_array.h"
+
+namespace routeguide
+{
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /**
+     * @brief 将 (latitude, longitude) 打包成一个 64 位整数，高 32 位为纬度，低 32 位为经度
+     *
+     * @param latitude 纬度（E7 表示）
+     * @param longitude 经度（E7 表示）
+     * @return uint64_t 打包后的键值
+     */
+    inline uint64_t PackPoint(int32_t latitude, int32_t longitude)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(latitude)) << 32) |
+               static_cast<uint64_t>(static_cast<uint32_t>(longitude));
+    }
+
+    /**
+     * @brief 开放寻址（线性探测）哈希表，键为 PackPoint 的结果，值为 feature 行号。
+     * 构建后只读，查找只访问连续的槽位数组，查找开销不随数据量增长。
+     *
+     */
+    class PointIndex
+    {
+    public:
+        static const uint32_t kNotFound = 0xFFFFFFFFu;
+
+        /**
+         * @brief 预分配可容纳 n 个元素的槽位，负载因子不超过 0.5
+         *
+         * @param n 预计元素个数
+         */
+        void Reserve(size_t n);
+
+        /**
+         * @brief 插入一条记录。键已存在时保留先插入的行号，与按顺序线性查找的结果保持一致
+         *
+         * @param key PackPoint 生成的键
+         * @param row feature 行号
+         */
+        void Insert(uint64_t key, uint32_t row);
+
+        /**
+         * @brief 查找键对应的行号
+         *
+         * @param key PackPoint 生成的键
+         * @return uint32_t 行号，不存在时返回 kNotFound
+         */
+        uint32_t Find(uint64_t key) const;
+
+        size_t size() const { return size_; }
+
+        /**
+         * @brief 写入快照 / 从快照读取，读出的槽位数组直接引用快照文件的映射。
+         * 读取时逐个检查槽位，保证行号都小于 rows，且至少有一个空槽（否则 Find 会无限探测）
+         *
+         */
+        void Save(SnapshotWriter *writer) const;
+        bool Load(SnapshotReader *reader, size_t rows);
+
+    private:
+        struct Slot
+        {
+            uint64_t key;
+            uint32_t row;     // kNotFound 表示空槽
+            uint32_t padding; // 显式补齐到 16 字节并始终为 0，槽数组原样写入快照，文件内容不能依赖未初始化的字节
+        };
+
+        static uint64_t Hash(uint64_t key);
+        void Grow();
+
+        FlatArray<Slot> slots_;
+        size_t mask_ = 0;
+        size_t size_ = 0;
+    };
+
+} // namespace routeguide
+
+#endif //_POINT_INDEX_H_
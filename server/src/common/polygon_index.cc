@@ -0,0 +1,210 @@
+#include <algorithm>
+
+#include "polygon_index.h"
+
+namespace routeguide
+{
+    const size_t PolygonIndex::kMaxBands;
+    const size_t PolygonIndex::kMaxCopiesPerEdge;
+
+    size_t PolygonIndex::BandCopies(const int32_t *lat, size_t n) const
+    {
+        size_t copies = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t j = (i + 1) % n;
+            if (lat[i] != lat[j])
+            {
+                copies += Band(std::max(lat[i], lat[j])) - Band(std::min(lat[i], lat[j])) + 1;
+            }
+        }
+        return copies;
+    }
+
+    bool PolygonIndex::Build(const int32_t *lat, const int32_t *lon, size_t n)
+    {
+        band_begin_.clear();
+        y1_.clear();
+        y2_.clear();
+        x1_.clear();
+        slope_.clear();
+        bands_ = 0;
+        edge_count_ = 0;
+        if (n < 3)
+        {
+            return false;
+        }
+
+        bounds_.min_lat = bounds_.max_lat = lat[0];
+        bounds_.min_lon = bounds_.max_lon = lon[0];
+        for (size_t i = 1; i < n; i++)
+        {
+            bounds_.min_lat = std::min(bounds_.min_lat, lat[i]);
+            bounds_.max_lat = std::max(bounds_.max_lat, lat[i]);
+            bounds_.min_lon = std::min(bounds_.min_lon, lon[i]);
+            bounds_.max_lon = std::max(bounds_.max_lon, lon[i]);
+        }
+        edge_count_ = n;
+        // 条带数与边数相当时，大部分边只落在一两条带内；边普遍很长时条带数减半，
+        // 直到复制总数不超过预算（只有一条带时每条边只有一份，一定满足）
+        bands_ = std::max<size_t>(1, std::min(n, kMaxBands));
+        while (bands_ > 1 && BandCopies(lat, n) > n * kMaxCopiesPerEdge)
+        {
+            bands_ /= 2;
+        }
+
+        // 1. 统计每条带的边数
+        std::vector<size_t> count(bands_ + 1, 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t j = (i + 1) % n;
+            if (lat[i] == lat[j])
+            {
+                continue;
+            }
+            size_t first = Band(std::min(lat[i], lat[j]));
+            size_t last = Band(std::max(lat[i], lat[j]));
+            for (size_t b = first; b <= last; b++)
+            {
+                count[b + 1]++;
+            }
+        }
+        for (size_t b = 0; b < bands_; b++)
+        {
+            count[b + 1] += count[b];
+        }
+        band_begin_ = count;
+
+        // 2. 按条带填充边
+        size_t total = band_begin_[bands_];
+        y1_.resize(total);
+        y2_.resize(total);
+        x1_.resize(total);
+        slope_.resize(total);
+        std::vector<size_t> cursor(band_begin_.begin(), band_begin_.end() - 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t j = (i + 1) % n;
+            if (lat[i] == lat[j])
+            {
+                continue;
+            }
+            double slope = static_cast<double>(static_cast<int64_t>(lon[j]) - lon[i]) /
+                           static_cast<double>(static_cast<int64_t>(lat[j]) - lat[i]);
+            size_t first = Band(std::min(lat[i], lat[j]));
+            size_t last = Band(std::max(lat[i], lat[j]));
+            for (size_t b = first; b <= last; b++)
+            {
+                size_t e = cursor[b]++;
+                y1_[e] = lat[i];
+                y2_[e] = lat[j];
+                x1_[e] = lon[i];
+                slope_[e] = slope;
+            }
+        }
+        return true;
+    }
+
+    bool PolygonIndex::Contains(int32_t lat, int32_t lon) const
+    {
+        if (bands_ == 0 || !bounds_.Contains(lat, lon))
+        {
+            return false;
+        }
+        size_t band = Band(lat);
+        double py = lat;
+        double px = lon;
+        bool inside = false;
+        for (size_t e = band_begin_[band]; e < band_begin_[band + 1]; e++)
+        {
+            // 边跨过 py 所在的水平线（半开区间，顶点只计一次），且交点在点的东侧
+            if ((y1_[e] > py) != (y2_[e] > py) && px < x1_[e] + (py - y1_[e]) * slope_[e])
+            {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    void PolygonIndex::Filter(const int32_t *lat, const int32_t *lon, size_t n, std::vector<uint32_t> *out) const
+    {
+        if (bands_ == 0)
+        {
+            return;
+        }
+
+        // 1. 按条带对包围盒内的点做计数排序
+        std::vector<uint32_t> begin(bands_ + 1, 0);
+        std::vector<uint32_t> band_of(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (bounds_.Contains(lat[i], lon[i]))
+            {
+                band_of[i] = static_cast<uint32_t>(Band(lat[i]));
+                begin[band_of[i] + 1]++;
+            }
+            else
+            {
+                band_of[i] = static_cast<uint32_t>(bands_);
+            }
+        }
+        for (size_t b = 0; b < bands_; b++)
+        {
+            begin[b + 1] += begin[b];
+        }
+        size_t candidates = begin[bands_];
+        std::vector<uint32_t> order(candidates);
+        std::vector<double> py(candidates);
+        std::vector<double> px(candidates);
+        std::vector<uint32_t> cursor(begin.begin(), begin.end() - 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (band_of[i] < bands_)
+            {
+                uint32_t k = cursor[band_of[i]]++;
+                order[k] = static_cast<uint32_t>(i);
+                py[k] = lat[i];
+                px[k] = lon[i];
+            }
+        }
+
+        // 2. 逐条带、逐条边翻转组内每个点的奇偶位
+        std::vector<uint8_t> inside(candidates, 0);
+        for (size_t b = 0; b < bands_; b++)
+        {
+            uint32_t first = begin[b];
+            uint32_t last = begin[b + 1];
+            if (first == last)
+            {
+                continue;
+            }
+            for (size_t e = band_begin_[b]; e < band_begin_[b + 1]; e++)
+            {
+                double y1 = y1_[e];
+                double y2 = y2_[e];
+                double x1 = x1_[e];
+                double slope = slope_[e];
+                for (uint32_t k = first; k < last; k++)
+                {
+                    inside[k] ^= static_cast<uint8_t>(((y1 > py[k]) != (y2 > py[k])) &
+                                                      (px[k] < x1 + (py[k] - y1) * slope));
+                }
+            }
+        }
+
+        // 3. 按原下标顺序输出，复用 band_of 标记命中的点
+        std::fill(band_of.begin(), band_of.end(), 0);
+        for (size_t k = 0; k < candidates; k++)
+        {
+            band_of[order[k]] = inside[k];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (band_of[i] != 0)
+            {
+                out->push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+} // namespace routeguide
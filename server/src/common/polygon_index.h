@@ -0,0 +1,91 @@
+/**
+ * @file polygon_index.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 多边形包含判断：按纬度分带的边索引 + 批量射线法
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _POLYGON_INDEX_H_
+#define _POLYGON_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "spatial_index.h"
+
+namespace routeguide
+{
+    /**
+     * @brief 简单多边形（首尾顶点自动相连）的点包含判断，使用奇偶规则。
+     * 构建时把纬度范围等分为若干条带，每条带只记录纬度跨度与之相交的边，
+     * 判断一个点时只需检查它所在条带的边，顶点数很多时单点代价仍接近常数。
+     * 每个请求构建一次，构建后只读。
+     *
+     */
+    class PolygonIndex
+    {
+    public:
+        static const size_t kMaxBands = 4096;
+        // 每条边会复制到它跨过的每条带中，复制总数超过 顶点数 * kMaxCopiesPerEdge 时减少条带数，
+        // 避免跨越整个纬度范围的锯齿形多边形产生 顶点数 * kMaxBands 份复制
+        static const size_t kMaxCopiesPerEdge = 8;
+
+        /**
+         * @brief 构建边索引，会覆盖之前的内容
+         *
+         * @param lat 顶点纬度数组
+         * @param lon 顶点经度数组
+         * @param n 顶点个数
+         * @return bool 顶点少于 3 个时返回 false
+         */
+        bool Build(const int32_t *lat, const int32_t *lon, size_t n);
+
+        /**
+         * @brief 多边形的包围盒，可用于在空间索引中预筛选候选点
+         *
+         */
+        const BoundingBox &bounds() const { return bounds_; }
+
+        bool Contains(int32_t lat, int32_t lon) const;
+
+        /**
+         * @brief 批量判断 [0, n) 内的点，命中时把下标 i 追加写入 out，按下标升序输出。
+         * 先把点按条带分组，再对每条带的每条边遍历组内所有点，内层循环无分支，便于编译器向量化
+         *
+         */
+        void Filter(const int32_t *lat, const int32_t *lon, size_t n, std::vector<uint32_t> *out) const;
+
+        size_t edge_count() const { return edge_count_; }
+
+    private:
+        size_t Band(int32_t lat) const
+        {
+            return static_cast<size_t>((static_cast<int64_t>(lat) - bounds_.min_lat) * bands_ /
+                                       (static_cast<int64_t>(bounds_.max_lat) - bounds_.min_lat + 1));
+        }
+
+        /**
+         * @brief 按当前的条带数，所有非水平边复制到各条带后的总份数
+         *
+         */
+        size_t BandCopies(const int32_t *lat, size_t n) const;
+
+        BoundingBox bounds_;
+        size_t bands_ = 0;
+        size_t edge_count_ = 0;
+
+        // 各条带的边按条带连续存放，第 b 条带为 [band_begin_[b], band_begin_[b + 1])
+        // 边用起点 (y1, x1)、终点纬度 y2 以及经度对纬度的斜率表示，水平边不参与射线判断，不存放
+        std::vector<size_t> band_begin_;
+        std::vector<double> y1_;
+        std::vector<double> y2_;
+        std::vector<double> x1_;
+        std::vector<double> slope_;
+    };
+
+} // namespace routeguide
+
+#endif //_POLYGON_INDEX_H_
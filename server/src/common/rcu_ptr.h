@@ -0,0 +1,104 @@
+/**
+ * @file rcu_ptr.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief RCU 风格的 shared_ptr 发布单元：读取端无锁，写入端原子切换快照
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _RCU_PTR_H_
+#define _RCU_PTR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace routeguide
+{
+    /**
+     * @brief 保存一个只读快照 std::shared_ptr<const T>，支持并发读取和原子替换。
+     * 内部有两个槽位，current_ 指向当前生效的槽位。读取端先登记到槽位的读者计数，
+     * 确认槽位仍然生效后复制 shared_ptr，全程只有原子加减，不会加锁也不会被写入端阻塞。
+     * 写入端把新快照写入空闲槽位后切换 current_，再等待旧槽位上的读者离开并释放引用；
+     * 已经取得旧快照的调用方不受影响，最后一个持有者负责析构旧快照。
+     *
+     */
+    template <typename T>
+    class RcuPtr
+    {
+    public:
+        RcuPtr() : current_(0)
+        {
+            slots_[0].readers = 0;
+            slots_[1].readers = 0;
+        }
+
+        explicit RcuPtr(std::shared_ptr<const T> value) : RcuPtr()
+        {
+            slots_[0].value = std::move(value);
+        }
+
+        RcuPtr(const RcuPtr &) = delete;
+        RcuPtr &operator=(const RcuPtr &) = delete;
+
+        /**
+         * @brief 获取当前快照，无锁
+         *
+         */
+        std::shared_ptr<const T> Load() const
+        {
+            while (true)
+            {
+                uint32_t index = current_.load();
+                Slot &slot = slots_[index];
+                slot.readers.fetch_add(1);
+                // 登记后再确认一次，期间发生过切换则该槽位可能正在被改写，重试
+                if (current_.load() == index)
+                {
+                    std::shared_ptr<const T> value = slot.value;
+                    slot.readers.fetch_sub(1);
+                    return value;
+                }
+                slot.readers.fetch_sub(1);
+            }
+        }
+
+        /**
+         * @brief 发布新快照，多个写入端之间串行执行
+         *
+         */
+        void Store(std::shared_ptr<const T> value)
+        {
+            std::lock_guard<std::mutex> lock(writer_mu_);
+            uint32_t old_index = current_.load();
+            uint32_t new_index = 1 - old_index;
+            // 空闲槽位在上一次切换后已经没有有效读者，可以直接改写
+            slots_[new_index].value = std::move(value);
+            current_.store(new_index);
+
+            // 等待仍在复制旧快照的读者离开，读者的临界区只是一次 shared_ptr 复制
+            while (slots_[old_index].readers.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+            slots_[old_index].value.reset();
+        }
+
+    private:
+        struct Slot
+        {
+            std::shared_ptr<const T> value;
+            std::atomic<uint64_t> readers;
+        };
+
+        mutable Slot slots_[2];
+        std::atomic<uint32_t> current_;
+        std::mutex writer_mu_;
+    };
+
+} // namespace routeguide
+
+#endif //_RCU_PTR_H_
@@ -0,0 +1,155 @@
+#include "rect_filter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RECT_FILTER_X86 1
+#endif
+
+namespace routeguide
+{
+    namespace
+    {
+        size_t RectFilterScalar(const int32_t *lat, const int32_t *lon, size_t n,
+                                const BoundingBox &box, uint32_t base, uint32_t *out)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                // 无分支写入：总是写，命中时才前移
+                out[count] = base + static_cast<uint32_t>(i);
+                count += box.Contains(lat[i], lon[i]) ? 1 : 0;
+            }
+            return count;
+        }
+
+#ifdef RECT_FILTER_X86
+        __attribute__((target("avx2"))) size_t RectFilterAvx2(const int32_t *lat, const int32_t *lon, size_t n,
+                                                               const BoundingBox &box, uint32_t base, uint32_t *out)
+        {
+            const __m256i min_lat = _mm256_set1_epi32(box.min_lat);
+            const __m256i max_lat = _mm256_set1_epi32(box.max_lat);
+            const __m256i min_lon = _mm256_set1_epi32(box.min_lon);
+            const __m256i max_lon = _mm256_set1_epi32(box.max_lon);
+
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i la = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lat + i));
+                __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lon + i));
+                // AVX2 只有有符号的大于比较，先求出越界的通道，再取反
+                __m256i outside = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpgt_epi32(min_lat, la), _mm256_cmpgt_epi32(la, max_lat)),
+                    _mm256_or_si256(_mm256_cmpgt_epi32(min_lon, lo), _mm256_cmpgt_epi32(lo, max_lon)));
+                unsigned mask = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xFFu;
+                while (mask != 0)
+                {
+                    out[count++] = base + static_cast<uint32_t>(i + __builtin_ctz(mask));
+                    mask &= mask - 1;
+                }
+            }
+            return count + RectFilterScalar(lat + i, lon + i, n - i, box,
+                                            base + static_cast<uint32_t>(i), out + count);
+        }
+
+        __attribute__((target("avx512f"))) size_t RectFilterAvx512(const int32_t *lat, const int32_t *lon, size_t n,
+                                                                   const BoundingBox &box, uint32_t base, uint32_t *out)
+        {
+            const __m512i min_lat = _mm512_set1_epi32(box.min_lat);
+            const __m512i max_lat = _mm512_set1_epi32(box.max_lat);
+            const __m512i min_lon = _mm512_set1_epi32(box.min_lon);
+            const __m512i max_lon = _mm512_set1_epi32(box.max_lon);
+            const __m512i step = _mm512_set1_epi32(16);
+            __m512i index = _mm512_add_epi32(
+                _mm512_set1_epi32(static_cast<int32_t>(base)),
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m512i la = _mm512_loadu_si512(lat + i);
+                __m512i lo = _mm512_loadu_si512(lon + i);
+                __mmask16 mask = _mm512_cmpge_epi32_mask(la, min_lat);
+                mask = _mm512_mask_cmple_epi32_mask(mask, la, max_lat);
+                mask = _mm512_mask_cmpge_epi32_mask(mask, lo, min_lon);
+                mask = _mm512_mask_cmple_epi32_mask(mask, lo, max_lon);
+                // 直接把命中通道的下标压缩写入输出数组
+                _mm512_mask_compressstoreu_epi32(out + count, mask, index);
+                count += __builtin_popcount(mask);
+                index = _mm512_add_epi32(index, step);
+            }
+            return count + RectFilterScalar(lat + i, lon + i, n - i, box,
+                                            base + static_cast<uint32_t>(i), out + count);
+        }
+#endif
+
+        RectFilterKernel DetectKernel()
+        {
+#ifdef RECT_FILTER_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+            {
+                return kRectFilterAvx512;
+            }
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return kRectFilterAvx2;
+            }
+#endif
+            return kRectFilterScalar;
+        }
+
+        RectFilterFn KernelFunction(RectFilterKernel kernel)
+        {
+            switch (kernel)
+            {
+#ifdef RECT_FILTER_X86
+            case kRectFilterAvx512:
+                return RectFilterAvx512;
+            case kRectFilterAvx2:
+                return RectFilterAvx2;
+#endif
+            default:
+                return RectFilterScalar;
+            }
+        }
+    } // namespace
+
+    RectFilterKernel BestRectFilterKernel()
+    {
+        static const RectFilterKernel kernel = DetectKernel();
+        return kernel;
+    }
+
+    bool RectFilterKernelSupported(RectFilterKernel kernel)
+    {
+        return kernel <= BestRectFilterKernel();
+    }
+
+    RectFilterFn GetRectFilter(RectFilterKernel kernel)
+    {
+        return RectFilterKernelSupported(kernel) ? KernelFunction(kernel) : RectFilterScalar;
+    }
+
+    const char *RectFilterKernelName(RectFilterKernel kernel)
+    {
+        switch (kernel)
+        {
+        case kRectFilterAvx512:
+            return "avx512";
+        case kRectFilterAvx2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+
+    size_t RectFilter(const int32_t *lat, const int32_t *lon, size_t n,
+                      const BoundingBox &box, uint32_t base, uint32_t *out)
+    {
+        static const RectFilterFn filter = KernelFunction(BestRectFilterKernel());
+        return filter(lat, lon, n, box, base, out);
+    }
+
+} // namespace routeguide
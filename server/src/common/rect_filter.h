@@ -0,0 +1,74 @@
+/**
+ * @file rect_filter.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 矩形过滤内核：对连续的经纬度列做四路边界比较，输出命中的下标列表
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _RECT_FILTER_H_
+#define _RECT_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "spatial_index.h"
+
+namespace routeguide
+{
+    /**
+     * @brief 过滤内核类型
+     *
+     */
+    enum RectFilterKernel
+    {
+        kRectFilterScalar = 0,
+        kRectFilterAvx2 = 1,   // 每次比较 8 个点
+        kRectFilterAvx512 = 2, // 每次比较 16 个点
+    };
+
+    /**
+     * @brief 过滤函数：检查 [0, n) 内每个点是否落在 box 内，命中时把 base + i 写入 out
+     *
+     * @param lat 纬度列
+     * @param lon 经度列
+     * @param n 点个数
+     * @param box 查询矩形
+     * @param base 输出下标的偏移量
+     * @param out 输出数组，调用方保证至少有 n 个元素的空间
+     * @return size_t 命中个数
+     */
+    typedef size_t (*RectFilterFn)(const int32_t *lat, const int32_t *lon, size_t n,
+                                   const BoundingBox &box, uint32_t base, uint32_t *out);
+
+    /**
+     * @brief 当前 CPU 支持的最快内核，第一次调用时通过 CPUID 检测并缓存
+     *
+     */
+    RectFilterKernel BestRectFilterKernel();
+
+    /**
+     * @brief 判断当前 CPU 是否支持指定内核
+     *
+     */
+    bool RectFilterKernelSupported(RectFilterKernel kernel);
+
+    /**
+     * @brief 获取指定内核的函数指针，CPU 不支持时返回标量实现
+     *
+     */
+    RectFilterFn GetRectFilter(RectFilterKernel kernel);
+
+    const char *RectFilterKernelName(RectFilterKernel kernel);
+
+    /**
+     * @brief 使用当前 CPU 支持的最快内核做过滤
+     *
+     */
+    size_t RectFilter(const int32_t *lat, const int32_t *lon, size_t n,
+                      const BoundingBox &box, uint32_t base, uint32_t *out);
+
+} // namespace routeguide
+
+#endif //_RECT_FILTER_H_
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+
+#include "spatial_index.h"
+#include "db_snapshot.h"
+#include "rect_filter.h"
+
+namespace routeguide
+{
+    const uint32_t SpatialIndex::kNodeCapacity;
+
+    namespace
+    {
+        /**
+         * @brief STR 排序：先按 x 排序并切成 ceil(sqrt(P)) 个竖条，再在每个竖条内按 y 排序，
+         * 之后按顺序每 capacity 个元素打包成一个节点
+         *
+         */
+        template <typename XFn, typename YFn>
+        void StrSort(std::vector<uint32_t> *order, uint32_t capacity, XFn x, YFn y)
+        {
+            size_t n = order->size();
+            size_t pages = (n + capacity - 1) / capacity;
+            size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(pages))));
+            size_t slice_size = std::max<size_t>(1, slices) * capacity;
+
+            std::sort(order->begin(), order->end(),
+                      [&x](uint32_t a, uint32_t b) { return x(a) < x(b); });
+            for (size_t begin = 0; begin < n; begin += slice_size)
+            {
+                size_t end = std::min(n, begin + slice_size);
+                std::sort(order->begin() + begin, order->begin() + end,
+                          [&y](uint32_t a, uint32_t b) { return y(a) < y(b); });
+            }
+        }
+
+        BoundingBox EmptyBox()
+        {
+            BoundingBox box = {INT32_MAX, INT32_MIN, INT32_MAX, INT32_MIN};
+            return box;
+        }
+
+        void Extend(BoundingBox *box, const BoundingBox &other)
+        {
+            box->min_lat = std::min(box->min_lat, other.min_lat);
+            box->max_lat = std::max(box->max_lat, other.max_lat);
+            box->min_lon = std::min(box->min_lon, other.min_lon);
+            box->max_lon = std::max(box->max_lon, other.max_lon);
+        }
+
+        int64_t Center(int32_t lo, int32_t hi)
+        {
+            return static_cast<int64_t>(lo) + hi;
+        }
+
+        /**
+         * @brief 最近邻搜索队列元素：节点或条目
+         *
+         */
+        struct SearchItem
+        {
+            double distance;
+            uint32_t index;
+            bool is_entry;
+
+            bool operator>(const SearchItem &other) const
+            {
+                // 距离相同时条目优先出队，尽早结束搜索
+                if (distance != other.distance)
+                {
+                    return distance > other.distance;
+                }
+                return !is_entry && other.is_entry;
+            }
+        };
+    } // namespace
+
+    void SpatialIndex::Build(const int32_t *lat, const int32_t *lon, size_t n)
+    {
+        lat_.clear();
+        lon_.clear();
+        ids_.clear();
+        nodes_.clear();
+        level_begin_.clear();
+        if (n == 0)
+        {
+            return;
+        }
+
+        // 1. 对所有点做 STR 排序，生成叶子层
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        StrSort(&order, kNodeCapacity,
+                [lon](uint32_t i) { return lon[i]; },
+                [lat](uint32_t i) { return lat[i]; });
+
+        std::vector<std::vector<Node>> levels(1);
+        for (size_t begin = 0; begin < n; begin += kNodeCapacity)
+        {
+            Node leaf;
+            leaf.box = EmptyBox();
+            leaf.child_begin = leaf.child_end = 0;
+            leaf.entry_begin = static_cast<uint32_t>(begin);
+            leaf.entry_end = static_cast<uint32_t>(std::min(n, begin + kNodeCapacity));
+            for (uint32_t e = leaf.entry_begin; e < leaf.entry_end; e++)
+            {
+                BoundingBox point = {lat[order[e]], lat[order[e]], lon[order[e]], lon[order[e]]};
+                Extend(&leaf.box, point);
+            }
+            levels.back().push_back(leaf);
+        }
+
+        // 2. 逐层向上对节点中心做 STR 排序并打包，直到只剩根节点
+        while (levels.back().size() > 1)
+        {
+            std::vector<Node> &current = levels.back();
+            std::vector<uint32_t> node_order(current.size());
+            std::iota(node_order.begin(), node_order.end(), 0);
+            StrSort(&node_order, kNodeCapacity,
+                    [&current](uint32_t i) { return Center(current[i].box.min_lon, current[i].box.max_lon); },
+                    [&current](uint32_t i) { return Center(current[i].box.min_lat, current[i].box.max_lat); });
+
+            std::vector<Node> sorted;
+            sorted.reserve(current.size());
+            for (uint32_t i : node_order)
+            {
+                sorted.push_back(current[i]);
+            }
+            current.swap(sorted);
+
+            std::vector<Node> parents;
+            for (size_t begin = 0; begin < current.size(); begin += kNodeCapacity)
+            {
+                Node parent;
+                parent.box = EmptyBox();
+                parent.child_begin = static_cast<uint32_t>(begin);
+                parent.child_end = static_cast<uint32_t>(std::min(current.size(), begin + kNodeCapacity));
+                parent.entry_begin = parent.entry_end = 0;
+                for (uint32_t c = parent.child_begin; c < parent.child_end; c++)
+                {
+                    Extend(&parent.box, current[c].box);
+                }
+                parents.push_back(parent);
+            }
+            levels.push_back(parents);
+        }
+
+        // 3. 自顶向下重排各层，使每个子树覆盖的下层节点和条目都是连续的
+        for (size_t level = levels.size() - 1; level > 0; level--)
+        {
+            std::vector<Node> children;
+            children.reserve(levels[level - 1].size());
+            for (Node &node : levels[level])
+            {
+                uint32_t begin = static_cast<uint32_t>(children.size());
+                children.insert(children.end(),
+                                levels[level - 1].begin() + node.child_begin,
+                                levels[level - 1].begin() + node.child_end);
+                node.child_begin = begin;
+                node.child_end = static_cast<uint32_t>(children.size());
+            }
+            levels[level - 1].swap(children);
+        }
+
+        lat_.reserve(n);
+        lon_.reserve(n);
+        ids_.reserve(n);
+        for (Node &leaf : levels[0])
+        {
+            uint32_t begin = static_cast<uint32_t>(ids_.size());
+            for (uint32_t e = leaf.entry_begin; e < leaf.entry_end; e++)
+            {
+                lat_.push_back(lat[order[e]]);
+                lon_.push_back(lon[order[e]]);
+                ids_.push_back(order[e]);
+            }
+            leaf.entry_begin = begin;
+            leaf.entry_end = static_cast<uint32_t>(ids_.size());
+        }
+
+        // 4. 按层展平，子节点下标换算为 nodes_ 中的绝对下标
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            uint32_t offset = static_cast<uint32_t>(nodes_.size());
+            level_begin_.push_back(offset);
+            for (Node node : levels[level])
+            {
+                if (level > 0)
+                {
+                    uint32_t child_offset = level_begin_[level - 1];
+                    node.child_begin += child_offset;
+                    node.child_end += child_offset;
+                    node.entry_begin = nodes_[node.child_begin].entry_begin;
+                    node.entry_end = nodes_[node.child_end - 1].entry_end;
+                }
+                nodes_.push_back(node);
+            }
+        }
+    }
+
+    void SpatialIndex::Query(const BoundingBox &box, std::vector<uint32_t> *rows) const
+    {
+        if (nodes_.empty())
+        {
+            return;
+        }
+        uint32_t leaf_end = level_begin_.size() > 1 ? level_begin_[1] : static_cast<uint32_t>(nodes_.size());
+
+        std::vector<uint32_t> stack;
+        stack.push_back(static_cast<uint32_t>(nodes_.size() - 1));
+        while (!stack.empty())
+        {
+            const Node &node = nodes_[stack.back()];
+            bool is_leaf = stack.back() < leaf_end;
+            stack.pop_back();
+
+            if (!box.Intersects(node.box))
+            {
+                continue;
+            }
+            if (box.Contains(node.box))
+            {
+                rows->insert(rows->end(), ids_.begin() + node.entry_begin, ids_.begin() + node.entry_end);
+                continue;
+            }
+            if (is_leaf)
+            {
+                uint32_t hits[kNodeCapacity];
+                size_t count = RectFilter(&lat_[node.entry_begin], &lon_[node.entry_begin],
+                                          node.entry_end - node.entry_begin, box, node.entry_begin, hits);
+                for (size_t i = 0; i < count; i++)
+                {
+                    rows->push_back(ids_[hits[i]]);
+                }
+                continue;
+            }
+            for (uint32_t c = node.child_end; c > node.child_begin; c--)
+            {
+                stack.push_back(c - 1);
+            }
+        }
+    }
+
+    size_t SpatialIndex::Count(const BoundingBox &box) const
+    {
+        if (nodes_.empty())
+        {
+            return 0;
+        }
+        uint32_t leaf_end = level_begin_.size() > 1 ? level_begin_[1] : static_cast<uint32_t>(nodes_.size());
+
+        size_t count = 0;
+        std::vector<uint32_t> stack;
+        stack.push_back(static_cast<uint32_t>(nodes_.size() - 1));
+        while (!stack.empty())
+        {
+            const Node &node = nodes_[stack.back()];
+            bool is_leaf = stack.back() < leaf_end;
+            stack.pop_back();
+
+            if (!box.Intersects(node.box))
+            {
+                continue;
+            }
+            if (box.Contains(node.box))
+            {
+                count += node.entry_end - node.entry_begin;
+                continue;
+            }
+            if (is_leaf)
+            {
+                uint32_t hits[kNodeCapacity];
+                count += RectFilter(&lat_[node.entry_begin], &lon_[node.entry_begin],
+                                    node.entry_end - node.entry_begin, box, node.entry_begin, hits);
+                continue;
+            }
+            for (uint32_t c = node.child_begin; c < node.child_end; c++)
+            {
+                stack.push_back(c);
+            }
+        }
+        return count;
+    }
+
+    void SpatialIndex::Nearest(size_t k, double max_distance,
+                               const std::function<double(const BoundingBox &)> &box_distance,
+                               const std::function<double(int32_t, int32_t)> &point_distance,
+                               std::vector<uint32_t> *rows, std::vector<double> *distances,
+                               const std::function<bool(uint32_t)> &filter) const
+    {
+        if (nodes_.empty() || k == 0)
+        {
+            return;
+        }
+        uint32_t leaf_end = level_begin_.size() > 1 ? level_begin_[1] : static_cast<uint32_t>(nodes_.size());
+
+        std::priority_queue<SearchItem, std::vector<SearchItem>, std::greater<SearchItem>> queue;
+        uint32_t root = static_cast<uint32_t>(nodes_.size() - 1);
+        SearchItem root_item = {box_distance(nodes_[root].box), root, false};
+        queue.push(root_item);
+
+        size_t found = 0;
+        while (!queue.empty() && found < k)
+        {
+            SearchItem item = queue.top();
+            queue.pop();
+            if (item.distance > max_distance)
+            {
+                break;
+            }
+            if (item.is_entry)
+            {
+                rows->push_back(ids_[item.index]);
+                if (distances != nullptr)
+                {
+                    distances->push_back(item.distance);
+                }
+                found++;
+                continue;
+            }
+
+            const Node &node = nodes_[item.index];
+            if (item.index < leaf_end)
+            {
+                for (uint32_t e = node.entry_begin; e < node.entry_end; e++)
+                {
+                    if (filter && !filter(ids_[e]))
+                    {
+                        continue;
+                    }
+                    double distance = point_distance(lat_[e], lon_[e]);
+                    if (distance <= max_distance)
+                    {
+                        SearchItem entry = {distance, e, true};
+                        queue.push(entry);
+                    }
+                }
+                continue;
+            }
+            for (uint32_t c = node.child_begin; c < node.child_end; c++)
+            {
+                double distance = box_distance(nodes_[c].box);
+                if (distance <= max_distance)
+                {
+                    SearchItem child = {distance, c, false};
+                    queue.push(child);
+                }
+            }
+        }
+    }
+
+    void SpatialIndex::Save(SnapshotWriter *writer) const
+    {
+        writer->Write(kTagSpatialLatitude, lat_);
+        writer->Write(kTagSpatialLongitude, lon_);
+        writer->Write(kTagSpatialIds, ids_);
+        writer->Write(kTagSpatialNodes, nodes_);
+        writer->Write(kTagSpatialLevels, level_begin_);
+    }
+
+    bool SpatialIndex::Load(SnapshotReader *reader)
+    {
+        if (!reader->Read(kTagSpatialLatitude, &lat_) || !reader->Read(kTagSpatialLongitude, &lon_) ||
+            !reader->Read(kTagSpatialIds, &ids_) || !reader->Read(kTagSpatialNodes, &nodes_) ||
+            !reader->Read(kTagSpatialLevels, &level_begin_))
+        {
+            return false;
+        }
+        if (lon_.size() != lat_.size() || ids_.size() != lat_.size() ||
+            (!nodes_.empty() && (level_begin_.empty() || level_begin_.back() >= nodes_.size())))
+        {
+            return reader->Fail("inconsistent spatial index");
+        }
+        if (!std::is_sorted(level_begin_.begin(), level_begin_.end()) ||
+            (!level_begin_.empty() && level_begin_[0] != 0))
+        {
+            return reader->Fail("bad spatial index levels");
+        }
+        // 条目行号必须是 [0, size) 内的值；节点的条目范围不能越界，内部节点的子节点必须位于
+        // 更低的层（下标小于自身），这样遍历既不会越界也一定会终止。
+        // 叶子节点的条目数不能超过 kNodeCapacity（查询时命中结果写入同样大小的栈上数组），
+        // 并且各叶子的条目范围依次首尾相接，恰好覆盖 [0, size)
+        size_t n = ids_.size();
+        if (std::find_if(ids_.begin(), ids_.end(), [n](uint32_t id) { return id >= n; }) != ids_.end())
+        {
+            return reader->Fail("spatial index row out of range");
+        }
+        uint32_t leaf_end = level_begin_.size() > 1 ? level_begin_[1] : static_cast<uint32_t>(nodes_.size());
+        size_t next_entry = 0;
+        for (size_t i = 0; i < nodes_.size(); i++)
+        {
+            const Node &node = nodes_[i];
+            if (node.entry_begin > node.entry_end || node.entry_end > n ||
+                (i >= leaf_end && (node.child_begin > node.child_end || node.child_end > i)))
+            {
+                return reader->Fail("bad spatial index node");
+            }
+            if (i < leaf_end)
+            {
+                if (node.entry_begin != next_entry || node.entry_end - node.entry_begin > kNodeCapacity)
+                {
+                    return reader->Fail("bad spatial index leaf");
+                }
+                next_entry = node.entry_end;
+            }
+        }
+        if (next_entry != n)
+        {
+            return reader->Fail("bad spatial index leaf");
+        }
+        return true;
+    }
+
+} // namespace routeguide
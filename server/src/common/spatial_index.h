@@ -0,0 +1,140 @@
+/**
+ * @file spatial_index.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 基于 STR(Sort-Tile-Recursive) 批量构建的静态 R 树，用于矩形范围查询
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _SPATIAL_INDEX_H_
+#define _SPATIAL_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "flat_array.h"
+
+namespace routeguide
+{
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /**
+     * @brief 经纬度包围盒（E7 表示，闭区间）
+     *
+     */
+    struct BoundingBox
+    {
+        int32_t min_lat;
+        int32_t max_lat;
+        int32_t min_lon;
+        int32_t max_lon;
+
+        bool Contains(int32_t lat, int32_t lon) const
+        {
+            return lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon;
+        }
+
+        bool Contains(const BoundingBox &other) const
+        {
+            return other.min_lat >= min_lat && other.max_lat <= max_lat &&
+                   other.min_lon >= min_lon && other.max_lon <= max_lon;
+        }
+
+        bool Intersects(const BoundingBox &other) const
+        {
+            return other.min_lat <= max_lat && other.max_lat >= min_lat &&
+                   other.min_lon <= max_lon && other.max_lon >= min_lon;
+        }
+    };
+
+    /**
+     * @brief 静态 R 树。
+     * 构建时按 STR 算法对所有点排序打包：叶子节点包含连续的 kNodeCapacity 个点，
+     * 上层节点同样按 STR 顺序排列，因此任意子树覆盖的点在条目数组中是连续的一段，
+     * 子树完全落在查询矩形内时可以直接整段输出，无需逐点比较。
+     *
+     */
+    class SpatialIndex
+    {
+    public:
+        static const uint32_t kNodeCapacity = 16;
+
+        /**
+         * @brief 批量构建索引，会覆盖之前的内容
+         *
+         * @param lat 纬度数组
+         * @param lon 经度数组
+         * @param n 点个数，行号即数组下标
+         */
+        void Build(const int32_t *lat, const int32_t *lon, size_t n);
+
+        /**
+         * @brief 查询落在 box 内的所有点，部分相交的叶子节点使用 RectFilter 内核做批量比较
+         *
+         * @param box 查询矩形
+         * @param rows 输出行号（追加写入），顺序为索引内部顺序
+         */
+        void Query(const BoundingBox &box, std::vector<uint32_t> *rows) const;
+
+        /**
+         * @brief 统计落在 box 内的点数。完全落在 box 内的子树直接累加其条目范围的长度，
+         * 只有与边界部分相交的叶子节点需要逐点比较
+         *
+         */
+        size_t Count(const BoundingBox &box) const;
+
+        /**
+         * @brief 最佳优先(best-first)最近邻搜索，按距离从近到远输出行号。
+         * 优先队列中同时存放节点和条目，节点的优先级为到包围盒的距离下界，
+         * 条目出队时即可确定它是剩余点中距离最近的。
+         *
+         * @param k 最多返回的个数
+         * @param max_distance 最大距离，超过该距离的点不返回
+         * @param box_distance 查询点到包围盒的距离下界，必须不大于 point_distance 对盒内任意点的结果
+         * @param point_distance 查询点到某个点的精确距离
+         * @param rows 输出行号（追加写入）
+         * @param distances 输出对应的距离（追加写入），可以为 nullptr
+         * @param filter 行号过滤条件，返回 false 的行被跳过且不计入 k，为空时不过滤
+         */
+        void Nearest(size_t k, double max_distance,
+                     const std::function<double(const BoundingBox &)> &box_distance,
+                     const std::function<double(int32_t, int32_t)> &point_distance,
+                     std::vector<uint32_t> *rows, std::vector<double> *distances,
+                     const std::function<bool(uint32_t)> &filter = nullptr) const;
+
+        size_t size() const { return ids_.size(); }
+
+        /**
+         * @brief 写入快照 / 从快照读取，读出的条目和节点数组直接引用快照文件的映射
+         *
+         */
+        void Save(SnapshotWriter *writer) const;
+        bool Load(SnapshotReader *reader);
+
+    private:
+        struct Node
+        {
+            BoundingBox box;
+            uint32_t child_begin; // 下一层节点下标范围，叶子节点不使用
+            uint32_t child_end;
+            uint32_t entry_begin; // 子树覆盖的条目范围
+            uint32_t entry_end;
+        };
+
+        // 条目按 STR 顺序存放，与行号一一对应
+        FlatArray<int32_t> lat_;
+        FlatArray<int32_t> lon_;
+        FlatArray<uint32_t> ids_;
+
+        // 所有节点按层存放，第 0 层为叶子，最后一个节点为根
+        FlatArray<Node> nodes_;
+        FlatArray<uint32_t> level_begin_;
+    };
+
+} // namespace routeguide
+
+#endif //_SPATIAL_INDEX_H_
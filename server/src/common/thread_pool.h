@@ -0,0 +1,58 @@
+/**
+ * @file thread_pool.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 固定大小的线程池，用于把一个大查询拆分到多个线程上并行执行
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace routeguide
+{
+    /**
+     * @brief 固定大小的线程池，任务按提交顺序执行。
+     * 任务不能抛出异常；析构时先执行完队列中剩余的任务再退出。
+     *
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @brief 启动工作线程
+         *
+         * @param threads 线程数，0 表示使用 CPU 核数
+         */
+        explicit ThreadPool(size_t threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void Submit(std::function<void()> task);
+
+        size_t size() const { return workers_.size(); }
+
+    private:
+        void WorkerLoop();
+
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopping_;
+        std::vector<std::thread> workers_;
+    };
+
+} // namespace routeguide
+
+#endif //_THREAD_POOL_H_
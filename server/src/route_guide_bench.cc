@@ -0,0 +1,1256 @@
+/**
+ * @file route_guide_bench.cc
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 性能测试程序入口，对比各种查询实现的耗时
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <grpcpp/grpcpp.h>
+
+#include "db_snapshot.h"
+#include "density_grid.h"
+#include "feature_db.h"
+#include "feature_store.h"
+#include "geo_util.h"
+#include "helper.h"
+#include "live_feature_db.h"
+#include "name_index.h"
+#include "polygon_index.h"
+#include "rect_filter.h"
+#include "spatial_index.h"
+
+#include "route_guide.grpc.pb.h"
+
+using routeguide::BoundingBox;
+using routeguide::Feature;
+using routeguide::FeatureDb;
+using routeguide::FeatureDelta;
+using routeguide::FeatureSnapshot;
+using routeguide::FeatureStore;
+using routeguide::GridLayout;
+using routeguide::NameIndex;
+using routeguide::Point;
+using routeguide::PolygonIndex;
+using routeguide::RectFilterFn;
+using routeguide::RectFilterKernel;
+using routeguide::RouteGuide;
+using routeguide::SpatialIndex;
+using routeguide::ThreadPool;
+using std::chrono::steady_clock;
+
+/**
+ * @brief 性能测试参数
+ *
+ */
+typedef struct STBenchConfig
+{
+    std::string Case;
+    size_t Features;
+    size_t Queries;
+    std::string Target;  // lookup 用例连接的服务端地址，如 localhost:20202
+    size_t Rate;         // lookup 用例每秒发起的查找次数
+    size_t Lookups;      // lookup 用例总查找次数
+    size_t Concurrency;  // lookup 用例一元调用的并发线程数
+} STBenchConfig;
+
+static STBenchConfig gBenchConfig = {"all", 1000000, 200, "", 2000, 20000, 16};
+
+// 与 route_guide_db.json 相同的区域：纬度 40~42，经度 -75~-73
+static const int32_t kMinLat = 400000000;
+static const int32_t kMaxLat = 420000000;
+static const int32_t kMinLon = -750000000;
+static const int32_t kMaxLon = -730000000;
+
+static int ParseArg(const char *sArg, const std::string &sKey, std::string &sVal)
+{
+    std::string argv = sArg;
+
+    size_t start_position = argv.find(sKey);
+    if (start_position != std::string::npos)
+    {
+        start_position += sKey.size();
+        if (argv[start_position] == ' ' || argv[start_position] == '=')
+        {
+            sVal = argv.substr(start_position + 1);
+        }
+        else
+            return -1;
+    }
+    else
+        return -1;
+
+    return 0;
+}
+
+static double ElapsedNs(steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(steady_clock::now() - start).count();
+}
+
+/**
+ * @brief 在测试区域内随机生成 feature
+ *
+ */
+static void GenerateFeatures(size_t n, std::vector<Feature> *feature_list, FeatureStore *store)
+{
+    std::mt19937 generator(20200805);
+    std::uniform_int_distribution<int32_t> lat_distribution(kMinLat, kMaxLat);
+    std::uniform_int_distribution<int32_t> lon_distribution(kMinLon, kMaxLon);
+
+    feature_list->resize(n);
+    store->Reserve(n, n * 16);
+    for (size_t i = 0; i < n; i++)
+    {
+        Feature &f = (*feature_list)[i];
+        f.set_name("feature-" + std::to_string(i));
+        f.mutable_location()->set_latitude(lat_distribution(generator));
+        f.mutable_location()->set_longitude(lon_distribution(generator));
+        store->Add(f.location().latitude(), f.location().longitude(), f.name());
+    }
+}
+
+/**
+ * @brief 生成覆盖区域面积比例为 selectivity 的随机查询矩形
+ *
+ */
+static std::vector<BoundingBox> GenerateQueries(size_t n, double selectivity)
+{
+    std::mt19937 generator(static_cast<unsigned>(selectivity * 1e9) + 1);
+    int32_t lat_span = static_cast<int32_t>((kMaxLat - kMinLat) * std::sqrt(selectivity));
+    int32_t lon_span = static_cast<int32_t>((static_cast<int64_t>(kMaxLon) - kMinLon) * std::sqrt(selectivity));
+    std::uniform_int_distribution<int32_t> lat_distribution(kMinLat, kMaxLat - lat_span);
+    std::uniform_int_distribution<int32_t> lon_distribution(kMinLon, kMaxLon - lon_span);
+
+    std::vector<BoundingBox> queries(n);
+    for (BoundingBox &box : queries)
+    {
+        box.min_lat = lat_distribution(generator);
+        box.max_lat = box.min_lat + lat_span;
+        box.min_lon = lon_distribution(generator);
+        box.max_lon = box.min_lon + lon_span;
+    }
+    return queries;
+}
+
+/**
+ * @brief 对比 std::vector<Feature> 与列式 FeatureStore 的内存占用和全表扫描耗时
+ *
+ */
+static void BenchFeatureStore(const std::vector<Feature> &feature_list, const FeatureStore &store)
+{
+    size_t vector_bytes = feature_list.capacity() * sizeof(Feature);
+    for (const Feature &f : feature_list)
+    {
+        vector_bytes += f.SpaceUsedLong() - sizeof(Feature);
+    }
+    std::printf("[store] bytes/feature: vector<Feature>=%.1f FeatureStore=%.1f\n",
+                static_cast<double>(vector_bytes) / feature_list.size(),
+                static_cast<double>(store.MemoryUsage()) / store.size());
+
+    std::vector<BoundingBox> queries = GenerateQueries(gBenchConfig.Queries, 0.01);
+    size_t vector_hits = 0;
+    size_t store_hits = 0;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (const BoundingBox &box : queries)
+    {
+        for (const Feature &f : feature_list)
+        {
+            vector_hits += box.Contains(f.location().latitude(), f.location().longitude()) ? 1 : 0;
+        }
+    }
+    double vector_ns = ElapsedNs(start);
+
+    start = steady_clock::now();
+    const int32_t *lat = store.latitudes();
+    const int32_t *lon = store.longitudes();
+    for (const BoundingBox &box : queries)
+    {
+        for (size_t i = 0; i < store.size(); i++)
+        {
+            store_hits += box.Contains(lat[i], lon[i]) ? 1 : 0;
+        }
+    }
+    double store_ns = ElapsedNs(start);
+
+    if (vector_hits != store_hits)
+    {
+        std::printf("[store] result mismatch: vector=%zu store=%zu\n", vector_hits, store_hits);
+        exit(-1);
+    }
+    double scanned = static_cast<double>(store.size()) * queries.size();
+    std::printf("[store] full scan: vector<Feature>=%.2f ns/feature FeatureStore=%.2f ns/feature\n",
+                vector_ns / scanned, store_ns / scanned);
+}
+
+/**
+ * @brief 对比 ListFeatures 原有的线性扫描与 R 树查询
+ *
+ */
+static void BenchSpatialIndex(const std::vector<Feature> &feature_list, const FeatureStore &store)
+{
+    steady_clock::time_point start = steady_clock::now();
+    SpatialIndex index;
+    index.Build(store.latitudes(), store.longitudes(), store.size());
+    std::printf("[spatial] build %zu entries: %.1f ms\n", index.size(), ElapsedNs(start) / 1e6);
+    std::printf("[spatial] %-12s %12s %16s %16s %10s\n", "selectivity", "avg_hits", "linear_ns/query", "rtree_ns/query", "speedup");
+
+    const double selectivities[] = {0.00001, 0.0001, 0.001, 0.01, 0.1, 0.5};
+    for (double selectivity : selectivities)
+    {
+        std::vector<BoundingBox> queries = GenerateQueries(gBenchConfig.Queries, selectivity);
+        std::vector<uint32_t> rows;
+        size_t linear_hits = 0;
+        size_t index_hits = 0;
+
+        start = steady_clock::now();
+        for (const BoundingBox &box : queries)
+        {
+            rows.clear();
+            for (size_t i = 0; i < feature_list.size(); i++)
+            {
+                const Feature &f = feature_list[i];
+                if (f.location().longitude() >= box.min_lon &&
+                    f.location().longitude() <= box.max_lon &&
+                    f.location().latitude() >= box.min_lat &&
+                    f.location().latitude() <= box.max_lat)
+                {
+                    rows.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            linear_hits += rows.size();
+        }
+        double linear_ns = ElapsedNs(start) / queries.size();
+
+        start = steady_clock::now();
+        for (const BoundingBox &box : queries)
+        {
+            rows.clear();
+            index.Query(box, &rows);
+            index_hits += rows.size();
+        }
+        double index_ns = ElapsedNs(start) / queries.size();
+
+        if (linear_hits != index_hits)
+        {
+            std::printf("[spatial] result mismatch: linear=%zu rtree=%zu\n", linear_hits, index_hits);
+            exit(-1);
+        }
+        std::printf("[spatial] %-12g %12.1f %16.0f %16.0f %9.1fx\n", selectivity,
+                    static_cast<double>(index_hits) / queries.size(), linear_ns, index_ns, linear_ns / index_ns);
+    }
+}
+
+/**
+ * @brief 对整列坐标运行各个矩形过滤内核，统计每秒扫描的 feature 数
+ *
+ */
+static void BenchRectFilter(const FeatureStore &store)
+{
+    const RectFilterKernel kernels[] = {routeguide::kRectFilterScalar, routeguide::kRectFilterAvx2,
+                                        routeguide::kRectFilterAvx512};
+    const double selectivities[] = {0.001, 0.1, 0.5};
+    std::vector<uint32_t> out(store.size());
+
+    std::printf("[simd] best kernel on this cpu: %s\n",
+                routeguide::RectFilterKernelName(routeguide::BestRectFilterKernel()));
+    std::printf("[simd] %-12s %-8s %12s %18s\n", "selectivity", "kernel", "avg_hits", "Mfeatures/s");
+    for (double selectivity : selectivities)
+    {
+        std::vector<BoundingBox> queries = GenerateQueries(gBenchConfig.Queries, selectivity);
+        size_t expected_hits = 0;
+        for (RectFilterKernel kernel : kernels)
+        {
+            if (!routeguide::RectFilterKernelSupported(kernel))
+            {
+                std::printf("[simd] %-12g %-8s %12s %18s\n", selectivity,
+                            routeguide::RectFilterKernelName(kernel), "-", "unsupported");
+                continue;
+            }
+            RectFilterFn filter = routeguide::GetRectFilter(kernel);
+            size_t hits = 0;
+            steady_clock::time_point start = steady_clock::now();
+            for (const BoundingBox &box : queries)
+            {
+                hits += filter(store.latitudes(), store.longitudes(), store.size(), box, 0, out.data());
+            }
+            double elapsed_ns = ElapsedNs(start);
+
+            if (kernel == routeguide::kRectFilterScalar)
+            {
+                expected_hits = hits;
+            }
+            else if (hits != expected_hits)
+            {
+                std::printf("[simd] result mismatch: scalar=%zu %s=%zu\n", expected_hits,
+                            routeguide::RectFilterKernelName(kernel), hits);
+                exit(-1);
+            }
+            double scanned = static_cast<double>(store.size()) * queries.size();
+            std::printf("[simd] %-12g %-8s %12.1f %18.1f\n", selectivity, routeguide::RectFilterKernelName(kernel),
+                        static_cast<double>(hits) / queries.size(), scanned / elapsed_ns * 1e3);
+        }
+    }
+}
+
+/**
+ * @brief 对比暴力排序与 R 树最佳优先搜索的 k 近邻查询，并校验两者结果一致
+ *
+ */
+static void BenchNearest(const FeatureStore &store)
+{
+    SpatialIndex index;
+    index.Build(store.latitudes(), store.longitudes(), store.size());
+
+    const size_t ks[] = {1, 10, 100};
+    std::vector<BoundingBox> queries = GenerateQueries(gBenchConfig.Queries, 0);
+    std::printf("[nearest] %-6s %18s %18s\n", "k", "brute_ns/query", "rtree_ns/query");
+    for (size_t k : ks)
+    {
+        double brute_ns = 0;
+        double index_ns = 0;
+        for (const BoundingBox &query : queries)
+        {
+            int32_t lat = query.min_lat;
+            int32_t lon = query.min_lon;
+
+            steady_clock::time_point start = steady_clock::now();
+            std::vector<float> expected(store.size());
+            for (size_t i = 0; i < store.size(); i++)
+            {
+                expected[i] = routeguide::GetDistance(lat, lon, store.latitude(i), store.longitude(i));
+            }
+            std::partial_sort(expected.begin(), expected.begin() + k, expected.end());
+            brute_ns += ElapsedNs(start);
+
+            start = steady_clock::now();
+            std::vector<uint32_t> rows;
+            std::vector<double> distances;
+            index.Nearest(
+                k, std::numeric_limits<double>::infinity(),
+                [lat, lon](const BoundingBox &box) { return routeguide::GetDistanceLowerBound(lat, lon, box); },
+                [lat, lon](int32_t feature_lat, int32_t feature_lon) {
+                    return static_cast<double>(routeguide::GetDistance(lat, lon, feature_lat, feature_lon));
+                },
+                &rows, &distances);
+            index_ns += ElapsedNs(start);
+
+            for (size_t i = 0; i < k; i++)
+            {
+                if (static_cast<float>(distances[i]) != expected[i])
+                {
+                    std::printf("[nearest] result mismatch at rank %zu: brute=%f rtree=%f\n", i, expected[i], distances[i]);
+                    exit(-1);
+                }
+            }
+        }
+        std::printf("[nearest] %-6zu %18.0f %18.0f\n", k, brute_ns / queries.size(), index_ns / queries.size());
+    }
+}
+
+/**
+ * @brief 对比 ListFeatures 每条结果现场序列化 Feature 与直接复制预编码数据，两者都生成发送用的 ByteBuffer
+ *
+ */
+static void BenchWireEncoding(const FeatureStore &store)
+{
+    FeatureStore copy = store;
+    FeatureDb db(std::move(copy), 1);
+
+    const double selectivities[] = {0.001, 0.01, 0.1};
+    std::printf("[wire] %-12s %12s %18s %18s\n", "selectivity", "rows/query", "serialize_ns/row", "encoded_ns/row");
+    for (double selectivity : selectivities)
+    {
+        std::vector<BoundingBox> queries = GenerateQueries(std::min<size_t>(gBenchConfig.Queries, 20), selectivity);
+        double serialize_ns = 0;
+        double encoded_ns = 0;
+        size_t total_rows = 0;
+        size_t checksum = 0;
+        for (const BoundingBox &query : queries)
+        {
+            std::vector<uint32_t> rows;
+            db.spatial_index().Query(query, &rows);
+            total_rows += rows.size();
+
+            steady_clock::time_point start = steady_clock::now();
+            Feature f;
+            for (uint32_t row : rows)
+            {
+                db.store().ToFeature(row, &f);
+                grpc::ByteBuffer buffer;
+                bool own_buffer = false;
+                grpc::SerializationTraits<Feature>::Serialize(f, &buffer, &own_buffer);
+                checksum += buffer.Length();
+            }
+            serialize_ns += ElapsedNs(start);
+
+            start = steady_clock::now();
+            for (uint32_t row : rows)
+            {
+                grpc::Slice slice(db.wire_data(row), db.wire_size(row));
+                grpc::ByteBuffer buffer(&slice, 1);
+                checksum -= buffer.Length();
+            }
+            encoded_ns += ElapsedNs(start);
+        }
+        if (checksum != 0)
+        {
+            std::printf("[wire] encoded size mismatch\n");
+            exit(-1);
+        }
+        size_t rows = std::max<size_t>(1, total_rows);
+        std::printf("[wire] %-12g %12zu %18.1f %18.1f\n", selectivity, total_rows / queries.size(),
+                    serialize_ns / rows, encoded_ns / rows);
+    }
+}
+
+/**
+ * @brief 对比 FeatureDensity 单线程与多线程扫描经纬度列统计网格计数，并校验两者结果一致
+ *
+ */
+static void BenchDensity(const FeatureStore &store)
+{
+    GridLayout layout;
+    layout.box.min_lat = kMinLat;
+    layout.box.max_lat = kMaxLat;
+    layout.box.min_lon = kMinLon;
+    layout.box.max_lon = kMaxLon;
+    layout.cols = 256;
+    layout.rows = 256;
+
+    size_t max_threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    size_t queries = std::min<size_t>(gBenchConfig.Queries, 20);
+    std::printf("[density] grid %ux%u over %zu features\n", layout.cols, layout.rows, store.size());
+    std::printf("[density] %-8s %14s %10s\n", "threads", "ms/query", "speedup");
+    std::vector<uint32_t> expected;
+    double single_ns = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        std::vector<uint32_t> counts;
+        std::vector<std::pair<size_t, size_t>> ranges(1, std::pair<size_t, size_t>(0, store.size()));
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads) : nullptr);
+        steady_clock::time_point start = steady_clock::now();
+        for (size_t q = 0; q < queries; q++)
+        {
+            routeguide::CountDensity(store.latitudes(), store.longitudes(), ranges, layout, pool.get(), &counts);
+        }
+        double elapsed_ns = ElapsedNs(start) / queries;
+
+        if (threads == 1)
+        {
+            expected = counts;
+            single_ns = elapsed_ns;
+        }
+        else if (counts != expected)
+        {
+            std::printf("[density] result mismatch with %zu threads\n", threads);
+            exit(-1);
+        }
+        std::printf("[density] %-8zu %14.2f %10.2f\n", threads, elapsed_ns / 1e6, single_ns / elapsed_ns);
+    }
+}
+
+/**
+ * @brief 对比 ListFeaturesInPolygon 对每个候选点遍历全部边的射线法与分带边索引批量判断，并校验两者结果一致
+ *
+ */
+static void BenchPolygon(const FeatureStore &store)
+{
+    SpatialIndex index;
+    index.Build(store.latitudes(), store.longitudes(), store.size());
+
+    const size_t vertex_counts[] = {16, 1000, 10000};
+    std::printf("[polygon] %-10s %12s %18s %18s %10s\n", "vertices", "hits", "naive_ms/query", "banded_ms/query", "speedup");
+    for (size_t n : vertex_counts)
+    {
+        // 以区域中心为圆心、边界呈锯齿状的近似圆形多边形，模拟服务区域的轮廓
+        std::vector<int32_t> vertex_lat(n);
+        std::vector<int32_t> vertex_lon(n);
+        double half = (kMaxLat - kMinLat) / 2.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double angle = 2 * M_PI * i / n;
+            double radius = (i % 2 == 0 ? 0.5 : 0.45) * half;
+            vertex_lat[i] = static_cast<int32_t>(kMinLat + half + radius * std::sin(angle));
+            vertex_lon[i] = static_cast<int32_t>(kMinLon + half + radius * std::cos(angle));
+        }
+        PolygonIndex polygon;
+        polygon.Build(vertex_lat.data(), vertex_lon.data(), n);
+
+        std::vector<uint32_t> rows;
+        index.Query(polygon.bounds(), &rows);
+        std::vector<int32_t> lat;
+        std::vector<int32_t> lon;
+        for (uint32_t row : rows)
+        {
+            lat.push_back(store.latitude(row));
+            lon.push_back(store.longitude(row));
+        }
+
+        // 朴素实现：每个候选点遍历全部边，点数或边数较多时只抽样一部分
+        size_t samples = std::min<size_t>(rows.size(), std::max<size_t>(1, 200000000 / (n * 4)));
+        size_t naive_hits = 0;
+        steady_clock::time_point start = steady_clock::now();
+        for (size_t k = 0; k < samples; k++)
+        {
+            bool inside = false;
+            for (size_t i = 0, j = n - 1; i < n; j = i++)
+            {
+                if ((vertex_lat[i] > lat[k]) != (vertex_lat[j] > lat[k]) &&
+                    lon[k] < vertex_lon[i] + static_cast<double>(lat[k] - vertex_lat[i]) *
+                                                 (static_cast<double>(vertex_lon[j]) - vertex_lon[i]) /
+                                                 (static_cast<double>(vertex_lat[j]) - vertex_lat[i]))
+                {
+                    inside = !inside;
+                }
+            }
+            naive_hits += inside ? 1 : 0;
+        }
+        double naive_ns = ElapsedNs(start) * rows.size() / std::max<size_t>(1, samples);
+
+        std::vector<uint32_t> hits;
+        start = steady_clock::now();
+        polygon.Filter(lat.data(), lon.data(), rows.size(), &hits);
+        double banded_ns = ElapsedNs(start);
+
+        size_t sampled_hits = std::lower_bound(hits.begin(), hits.end(), static_cast<uint32_t>(samples)) - hits.begin();
+        if (sampled_hits != naive_hits)
+        {
+            std::printf("[polygon] result mismatch with %zu vertices: naive=%zu banded=%zu\n", n, naive_hits, sampled_hits);
+            exit(-1);
+        }
+        std::printf("[polygon] %-10zu %12zu %18.2f %18.2f %10.1f\n", n, hits.size(), naive_ns / 1e6,
+                    banded_ns / 1e6, naive_ns / banded_ns);
+    }
+}
+
+/**
+ * @brief 对比 SearchFeatures 逐个扫描全部名称与名称索引的单次查询耗时，并校验两者结果一致
+ *
+ */
+static void BenchSearch(const FeatureStore &store)
+{
+    steady_clock::time_point start = steady_clock::now();
+    NameIndex index;
+    index.Build(store);
+    std::printf("[search] build %.1f ms, %.1f MB\n", ElapsedNs(start) / 1e6, index.MemoryUsage() / 1048576.0);
+
+    // 生成的名称形如 feature-123，查询串分别命中少量和大量名称
+    const char *queries[] = {"FEATURE-4242", "feature-1", "4242", "999", "-12345"};
+    const size_t limit = 10;
+    std::printf("[search] %-14s %-10s %14s %14s %10s\n", "query", "mode", "scan_us", "index_us", "speedup");
+    for (const char *query : queries)
+    {
+        std::string needle = NameIndex::Fold(query, std::strlen(query));
+        for (int mode = 0; mode < 2; mode++)
+        {
+            bool prefix = mode == 0;
+
+            // 朴素实现：逐个比较全部名称。前缀匹配要按名称排序，必须扫描全部名称；子串匹配找够 limit 个即可停止
+            std::vector<std::pair<std::string, uint32_t>> scanned;
+            start = steady_clock::now();
+            for (uint32_t row = 0; row < store.size(); row++)
+            {
+                std::string name = NameIndex::Fold(store.name_data(row), store.name_size(row));
+                if (prefix ? name.compare(0, needle.size(), needle) == 0 : name.find(needle) != std::string::npos)
+                {
+                    scanned.push_back(std::make_pair(name, row));
+                    if (!prefix && scanned.size() == limit)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (prefix)
+            {
+                std::sort(scanned.begin(), scanned.end());
+                scanned.resize(std::min(scanned.size(), limit));
+            }
+            double scan_ns = ElapsedNs(start);
+
+            std::vector<uint32_t> rows;
+            start = steady_clock::now();
+            for (size_t q = 0; q < gBenchConfig.Queries; q++)
+            {
+                rows.clear();
+                if (prefix)
+                {
+                    index.FindPrefix(query, limit, nullptr, &rows);
+                }
+                else
+                {
+                    index.FindSubstring(query, limit, nullptr, &rows);
+                }
+            }
+            double index_ns = ElapsedNs(start) / gBenchConfig.Queries;
+
+            bool match = rows.size() == scanned.size();
+            for (size_t i = 0; match && i < rows.size(); i++)
+            {
+                match = rows[i] == scanned[i].second;
+            }
+            if (!match)
+            {
+                std::printf("[search] result mismatch for \"%s\" (%s)\n", query, prefix ? "prefix" : "substring");
+                exit(-1);
+            }
+            std::printf("[search] %-14s %-10s %14.1f %14.1f %10.1f\n", query, prefix ? "prefix" : "substring",
+                        scan_ns / 1e3, index_ns / 1e3, scan_ns / index_ns);
+        }
+    }
+}
+
+/**
+ * @brief 对比加载顺序（随机）与 geohash 排序两种存储顺序下 ListFeatures 的矩形查询加结果构造耗时，
+ * 以及 geohash 前缀查询逐行比较与二分查找连续区间的耗时
+ *
+ */
+static void BenchGeohash(const FeatureStore &store)
+{
+    steady_clock::time_point start = steady_clock::now();
+    std::vector<std::pair<uint64_t, uint32_t>> keyed(store.size());
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        keyed[i] = std::make_pair(routeguide::GetGeohashKey(store.latitude(i), store.longitude(i)), static_cast<uint32_t>(i));
+    }
+    std::sort(keyed.begin(), keyed.end());
+    std::vector<uint32_t> order(store.size());
+    std::vector<uint64_t> keys(store.size());
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        keys[i] = keyed[i].first;
+        order[i] = keyed[i].second;
+    }
+    FeatureStore sorted = store;
+    sorted.Permute(order);
+    std::printf("[geohash] sort %zu features: %.1f ms\n", store.size(), ElapsedNs(start) / 1e6);
+
+    // 1. ListFeatures：R 树查询后对每个命中行构造 Feature，只有存储顺序不同
+    const FeatureStore *stores[] = {&store, &sorted};
+    SpatialIndex indexes[2];
+    for (int s = 0; s < 2; s++)
+    {
+        indexes[s].Build(stores[s]->latitudes(), stores[s]->longitudes(), stores[s]->size());
+    }
+    std::printf("[geohash] %-12s %12s %18s %18s %10s\n", "selectivity", "avg_hits", "load_order_us", "geohash_order_us", "speedup");
+    const double selectivities[] = {0.0001, 0.001, 0.01};
+    for (double selectivity : selectivities)
+    {
+        std::vector<BoundingBox> queries = GenerateQueries(gBenchConfig.Queries, selectivity);
+        double elapsed_ns[2];
+        size_t hits[2] = {0, 0};
+        for (int s = 0; s < 2; s++)
+        {
+            std::vector<uint32_t> rows;
+            Feature f;
+            start = steady_clock::now();
+            for (const BoundingBox &box : queries)
+            {
+                rows.clear();
+                indexes[s].Query(box, &rows);
+                for (uint32_t row : rows)
+                {
+                    stores[s]->ToFeature(row, &f);
+                    hits[s] += f.name().size() > 0 ? 1 : 0;
+                }
+            }
+            elapsed_ns[s] = ElapsedNs(start) / queries.size();
+        }
+        if (hits[0] != hits[1])
+        {
+            std::printf("[geohash] result mismatch: load_order=%zu geohash_order=%zu\n", hits[0], hits[1]);
+            exit(-1);
+        }
+        std::printf("[geohash] %-12g %12.1f %18.1f %18.1f %10.1f\n", selectivity,
+                    static_cast<double>(hits[1]) / queries.size(), elapsed_ns[0] / 1e3, elapsed_ns[1] / 1e3,
+                    elapsed_ns[0] / elapsed_ns[1]);
+    }
+
+    // 2. ListFeaturesByGeohash：以随机 feature 所在格子为查询前缀
+    std::printf("[geohash] %-12s %12s %18s %18s %10s\n", "prefix_len", "avg_hits", "scan_us", "range_us", "speedup");
+    std::mt19937 generator(20200805);
+    std::uniform_int_distribution<size_t> row_distribution(0, store.size() - 1);
+    for (size_t length = 3; length <= 6; length++)
+    {
+        std::vector<std::string> prefixes;
+        for (size_t q = 0; q < gBenchConfig.Queries; q++)
+        {
+            prefixes.push_back(routeguide::EncodeGeohash(keys[row_distribution(generator)], length));
+        }
+
+        size_t scan_hits = 0;
+        start = steady_clock::now();
+        for (size_t q = 0; q < prefixes.size() && q < 10; q++)
+        {
+            uint64_t lo = 0;
+            uint64_t hi = 0;
+            routeguide::GetGeohashRange(prefixes[q], &lo, &hi);
+            for (size_t i = 0; i < store.size(); i++)
+            {
+                uint64_t key = routeguide::GetGeohashKey(store.latitude(i), store.longitude(i));
+                scan_hits += key >= lo && key < hi ? 1 : 0;
+            }
+        }
+        double scan_ns = ElapsedNs(start) / std::min<size_t>(prefixes.size(), 10);
+
+        size_t range_hits = 0;
+        size_t sampled_hits = 0;
+        start = steady_clock::now();
+        for (size_t q = 0; q < prefixes.size(); q++)
+        {
+            uint64_t lo = 0;
+            uint64_t hi = 0;
+            routeguide::GetGeohashRange(prefixes[q], &lo, &hi);
+            size_t begin = std::lower_bound(keys.begin(), keys.end(), lo) - keys.begin();
+            size_t end = std::lower_bound(keys.begin() + begin, keys.end(), hi) - keys.begin();
+            range_hits += end - begin;
+            sampled_hits += q < 10 ? end - begin : 0;
+        }
+        double range_ns = ElapsedNs(start) / prefixes.size();
+
+        if (scan_hits != sampled_hits)
+        {
+            std::printf("[geohash] result mismatch for prefix length %zu: scan=%zu range=%zu\n", length, scan_hits, sampled_hits);
+            exit(-1);
+        }
+        std::printf("[geohash] %-12zu %12.1f %18.1f %18.3f %10.0f\n", length,
+                    static_cast<double>(range_hits) / prefixes.size(), scan_ns / 1e3, range_ns / 1e3, scan_ns / range_ns);
+    }
+}
+
+/**
+ * @brief 对比 ListFeatures 大范围查询在单线程 R 树查询与各空间分区并行查询(scatter-gather)下的耗时。
+ * 两种方式都由调用线程依次读取每个命中行的预编码数据，模拟写入返回流
+ *
+ */
+static void BenchScatter(const FeatureStore &store)
+{
+    steady_clock::time_point start = steady_clock::now();
+    FeatureStore copy = store;
+    FeatureSnapshot db(std::make_shared<const FeatureDb>(std::move(copy), 1), std::make_shared<const FeatureDelta>(), 1);
+    const FeatureDb &base = db.base();
+    ThreadPool pool(0);
+    std::printf("[scatter] build %zu features, %zu partitions, %zu threads: %.1f ms\n", base.store().size(),
+                base.partitions().size(), pool.size(), ElapsedNs(start) / 1e6);
+
+    std::printf("[scatter] %-12s %12s %16s %16s %10s\n", "selectivity", "avg_hits", "single_ms", "scatter_ms", "speedup");
+    const double selectivities[] = {0.001, 0.01, 0.1, 0.5};
+    size_t queries = std::max<size_t>(1, gBenchConfig.Queries / 10);
+    for (double selectivity : selectivities)
+    {
+        std::vector<BoundingBox> boxes = GenerateQueries(queries, selectivity);
+        size_t single_bytes = 0;
+        size_t scatter_bytes = 0;
+
+        start = steady_clock::now();
+        for (const BoundingBox &box : boxes)
+        {
+            std::vector<uint32_t> rows;
+            base.spatial_index().Query(box, &rows);
+            for (uint32_t row : rows)
+            {
+                single_bytes += base.wire_size(row) + static_cast<uint8_t>(base.wire_data(row)[0]);
+            }
+        }
+        double single_ns = ElapsedNs(start) / boxes.size();
+
+        start = steady_clock::now();
+        for (const BoundingBox &box : boxes)
+        {
+            db.ScatterQuery(box, &pool, [&base, &scatter_bytes](const std::vector<uint32_t> &rows) {
+                for (uint32_t row : rows)
+                {
+                    scatter_bytes += base.wire_size(row) + static_cast<uint8_t>(base.wire_data(row)[0]);
+                }
+            });
+        }
+        double scatter_ns = ElapsedNs(start) / boxes.size();
+
+        if (single_bytes != scatter_bytes)
+        {
+            std::printf("[scatter] result mismatch: single=%zu scatter=%zu\n", single_bytes, scatter_bytes);
+            exit(-1);
+        }
+        std::printf("[scatter] %-12g %12zu %16.2f %16.2f %10.1f\n", selectivity,
+                    static_cast<size_t>(selectivity * base.store().size()), single_ns / 1e6, scatter_ns / 1e6,
+                    single_ns / scatter_ns);
+    }
+}
+
+/**
+ * @brief 把 store 写成与 route_guide_db.json 相同格式的 JSON 数据库内容，名称中的引号和反斜杠按 JSON 转义
+ *
+ * @param ndjson 为 true 时写成每行一个 feature 的 NDJSON
+ */
+static std::string ToJsonDb(const FeatureStore &store, bool ndjson = false)
+{
+    std::string json = ndjson ? "" : "[";
+    json.reserve(store.name_bytes() + store.size() * 80);
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        if (i > 0)
+        {
+            json += ndjson ? "\n" : ",\n";
+        }
+        json += "{\"location\": {\"latitude\": ";
+        json += std::to_string(store.latitude(i));
+        json += ", \"longitude\": ";
+        json += std::to_string(store.longitude(i));
+        json += "}, \"name\": \"";
+        for (size_t k = 0; k < store.name_size(i); k++)
+        {
+            char c = store.name_data(i)[k];
+            if (c == '"' || c == '\\')
+            {
+                json.push_back('\\');
+            }
+            json.push_back(c);
+        }
+        json += "\"}";
+    }
+    json += ndjson ? "\n" : "]";
+    return json;
+}
+
+/**
+ * @brief 把 store 写成 varint 长度前缀分隔的 Feature 消息流
+ *
+ */
+static std::string ToProtobufDb(const FeatureStore &store)
+{
+    std::string pb;
+    google::protobuf::io::StringOutputStream output(&pb);
+    Feature feature;
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        store.ToFeature(i, &feature);
+        google::protobuf::util::SerializeDelimitedToZeroCopyStream(feature, &output);
+    }
+    return pb;
+}
+
+static bool SameFeatures(const FeatureStore &a, const FeatureStore &b)
+{
+    bool match = a.size() == b.size();
+    for (size_t i = 0; match && i < a.size(); i++)
+    {
+        match = a.latitude(i) == b.latitude(i) && a.longitude(i) == b.longitude(i) && a.name(i) == b.name(i);
+    }
+    return match;
+}
+
+/**
+ * @brief 数据库加载：分别用单线程和多线程解析 JSON 数组与 NDJSON 格式的数据库内容并写入列式存储；
+ * 再把三种格式写成文件，按服务端的方式从文件加载（JSON 数组内存映射，NDJSON 和 protobuf 流式读取）。
+ * 统计吞吐并校验加载结果与原数据一致
+ *
+ */
+static void BenchLoad(const FeatureStore &store)
+{
+    std::printf("[load] %-10s %8s %12s %12s %12s %14s %10s\n", "format", "threads", "features", "MB", "parse_ms",
+                "MB/s", "speedup");
+    const size_t kThreads[] = {1, 2, 4, 8};
+    for (int ndjson = 0; ndjson < 2; ndjson++)
+    {
+        std::string json = ToJsonDb(store, ndjson != 0);
+        double single_ns = 0;
+        for (size_t threads : kThreads)
+        {
+            FeatureStore parsed;
+            steady_clock::time_point start = steady_clock::now();
+            routeguide::ParseDbParallel(json.data(), json.size(), threads, &parsed);
+            double parse_ns = ElapsedNs(start);
+            single_ns = threads == 1 ? parse_ns : single_ns;
+
+            if (!SameFeatures(parsed, store))
+            {
+                std::printf("[load] result mismatch: parsed %zu of %zu features with %zu threads\n", parsed.size(),
+                            store.size(), threads);
+                exit(-1);
+            }
+            std::printf("[load] %-10s %8zu %12zu %12.1f %12.1f %14.1f %9.2fx\n", ndjson ? "ndjson" : "json",
+                        threads, parsed.size(), json.size() / 1048576.0, parse_ns / 1e6,
+                        json.size() / 1048576.0 / (parse_ns / 1e9), single_ns / parse_ns);
+        }
+    }
+
+    std::printf("[load] %-10s %8s %12s %12s %12s %14s\n", "file", "format", "features", "MB", "load_ms", "MB/s");
+    const char *kExtensions[] = {".json", ".ndjson", ".pb"};
+    for (int format = 0; format < 3; format++)
+    {
+        const std::string path = std::string("./route_guide_bench") + kExtensions[format];
+        std::string content = format == 2 ? ToProtobufDb(store) : ToJsonDb(store, format == 1);
+        std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc).write(content.data(), content.size());
+        content.clear();
+        content.shrink_to_fit();
+
+        FeatureStore loaded;
+        steady_clock::time_point start = steady_clock::now();
+        bool ok = routeguide::LoadDbFile(path, &loaded);
+        double load_ns = ElapsedNs(start);
+        size_t file_size = static_cast<size_t>(std::ifstream(path, std::ios::binary | std::ios::ate).tellg());
+        std::remove(path.c_str());
+        if (!ok || !SameFeatures(loaded, store))
+        {
+            std::printf("[load] result mismatch: loaded %zu of %zu features from %s\n", loaded.size(), store.size(),
+                        path.c_str());
+            exit(-1);
+        }
+        std::printf("[load] %-10s %8s %12zu %12.1f %12.1f %14.1f\n", kExtensions[format],
+                    format == 0 ? "mmap" : "stream", loaded.size(), file_size / 1048576.0, load_ns / 1e6,
+                    file_size / 1048576.0 / (load_ns / 1e9));
+    }
+}
+
+/**
+ * @brief 二进制快照：对比从 feature 数据构建全部索引与打开快照文件的耗时，并校验两者的查询结果一致
+ *
+ */
+static void BenchSnapshot(const FeatureStore &store)
+{
+    const std::string path = std::string("./route_guide_bench") + routeguide::kSnapshotExtension;
+
+    steady_clock::time_point start = steady_clock::now();
+    FeatureStore copy = store;
+    FeatureDb built(std::move(copy), 1);
+    double build_ns = ElapsedNs(start);
+
+    start = steady_clock::now();
+    if (!built.SaveSnapshot(path))
+    {
+        std::printf("[snapshot] failed to write %s\n", path.c_str());
+        exit(-1);
+    }
+    double save_ns = ElapsedNs(start);
+
+    start = steady_clock::now();
+    std::shared_ptr<const FeatureDb> mapped = FeatureDb::OpenSnapshot(path, 1);
+    double open_ns = ElapsedNs(start);
+
+    start = steady_clock::now();
+    routeguide::SnapshotReader reader;
+    bool valid = reader.Open(path) && reader.Verify();
+    double verify_ns = ElapsedNs(start);
+    if (!mapped || !valid)
+    {
+        std::printf("[snapshot] failed to open %s: %s\n", path.c_str(), reader.error());
+        exit(-1);
+    }
+
+    // 矩形查询、精确查找、名称检索和预编码数据都必须与构建结果一致
+    bool match = mapped->store().size() == built.store().size();
+    std::vector<BoundingBox> boxes = GenerateQueries(gBenchConfig.Queries, 0.001);
+    for (size_t i = 0; match && i < boxes.size(); i++)
+    {
+        std::vector<uint32_t> expected;
+        std::vector<uint32_t> actual;
+        built.spatial_index().Query(boxes[i], &expected);
+        mapped->spatial_index().Query(boxes[i], &actual);
+        match = expected == actual;
+    }
+    for (size_t row = 0; match && row < built.store().size(); row += 97)
+    {
+        uint64_t key = routeguide::PackPoint(built.store().latitude(row), built.store().longitude(row));
+        match = mapped->point_index().Find(key) == built.point_index().Find(key) &&
+                mapped->bloom_filter().MayContain(key) && mapped->store().name(row) == built.store().name(row) &&
+                std::string(mapped->wire_data(row), mapped->wire_size(row)) ==
+                    std::string(built.wire_data(row), built.wire_size(row));
+    }
+    const char *queries[] = {"road", "street", "12"};
+    for (size_t i = 0; match && i < sizeof(queries) / sizeof(queries[0]); i++)
+    {
+        std::vector<uint32_t> expected;
+        std::vector<uint32_t> actual;
+        built.name_index().FindSubstring(queries[i], 100, nullptr, &expected);
+        mapped->name_index().FindSubstring(queries[i], 100, nullptr, &actual);
+        built.name_index().FindPrefix(queries[i], 100, nullptr, &expected);
+        mapped->name_index().FindPrefix(queries[i], 100, nullptr, &actual);
+        match = expected == actual;
+    }
+    std::remove(path.c_str());
+    if (!match)
+    {
+        std::printf("[snapshot] result mismatch between built and mapped database\n");
+        exit(-1);
+    }
+
+    std::printf("[snapshot] %12s %12s %12s %12s %12s %12s\n", "features", "MB", "build_ms", "save_ms", "open_ms",
+                "verify_ms");
+    std::printf("[snapshot] %12zu %12.1f %12.1f %12.1f %12.3f %12.1f\n", mapped->store().size(),
+                reader.file_size() / 1048576.0, build_ns / 1e6, save_ns / 1e6, open_ns / 1e6, verify_ns / 1e6);
+}
+
+/**
+ * @brief 延迟统计：输出实际吞吐以及 p50/p99/max 延迟
+ *
+ */
+static void PrintLatency(const char *name, std::vector<double> *latency_us, double elapsed_s)
+{
+    if (latency_us->empty())
+    {
+        std::printf("[lookup] %-7s no result\n", name);
+        return;
+    }
+    std::sort(latency_us->begin(), latency_us->end());
+    size_t n = latency_us->size();
+    std::printf("[lookup] %-7s %10zu %14.0f %10.1f %10.1f %10.1f\n", name, n, n / elapsed_s,
+                (*latency_us)[n / 2], (*latency_us)[std::min(n - 1, n * 99 / 100)], latency_us->back());
+}
+
+/**
+ * @brief 从服务端取回全部 feature 的位置作为查找目标，取不到时使用随机位置
+ *
+ */
+static std::vector<Point> LoadLookupPoints(RouteGuide::Stub *stub, size_t n)
+{
+    std::vector<Point> locations;
+    grpc::ClientContext context;
+    routeguide::Rectangle rect;
+    rect.mutable_lo()->set_latitude(-900000000);
+    rect.mutable_lo()->set_longitude(-1800000000);
+    rect.mutable_hi()->set_latitude(900000000);
+    rect.mutable_hi()->set_longitude(1800000000);
+    std::unique_ptr<grpc::ClientReader<Feature>> reader(stub->ListFeatures(&context, rect));
+    Feature feature;
+    while (reader->Read(&feature))
+    {
+        locations.push_back(feature.location());
+    }
+    reader->Finish();
+
+    std::mt19937 generator(20200805);
+    std::uniform_int_distribution<int32_t> lat_distribution(kMinLat, kMaxLat);
+    std::uniform_int_distribution<int32_t> lon_distribution(kMinLon, kMaxLon);
+    std::vector<Point> points(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!locations.empty())
+        {
+            points[i] = locations[generator() % locations.size()];
+        }
+        else
+        {
+            points[i].set_latitude(lat_distribution(generator));
+            points[i].set_longitude(lon_distribution(generator));
+        }
+    }
+    return points;
+}
+
+/**
+ * @brief 在相同的请求速率下对比一元 GetFeature 与双向流 LookupStream 的延迟和吞吐。
+ * 按固定间隔排定每次查找的发起时间（开环），延迟从排定时间算起，
+ * 因此调用排队造成的等待也会计入延迟
+ *
+ */
+static void BenchLookup()
+{
+    std::shared_ptr<grpc::Channel> channel = grpc::CreateChannel(gBenchConfig.Target, grpc::InsecureChannelCredentials());
+    std::unique_ptr<RouteGuide::Stub> stub(RouteGuide::NewStub(channel));
+    std::vector<Point> points = LoadLookupPoints(stub.get(), gBenchConfig.Lookups);
+    std::chrono::nanoseconds interval(1000000000 / std::max<size_t>(1, gBenchConfig.Rate));
+
+    std::printf("[lookup] target=%s rate=%zu/s lookups=%zu concurrency=%zu\n", gBenchConfig.Target.c_str(),
+                gBenchConfig.Rate, points.size(), gBenchConfig.Concurrency);
+    std::printf("[lookup] %-7s %10s %14s %10s %10s %10s\n", "rpc", "lookups", "lookups/s", "p50_us", "p99_us", "max_us");
+
+    // 1. 一元调用：多个线程按排定时间领取查找任务，每次查找一个 ClientContext
+    {
+        std::vector<double> latency_us(points.size());
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> failed(0);
+        steady_clock::time_point start = steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < gBenchConfig.Concurrency; t++)
+        {
+            workers.push_back(std::thread([&]() {
+                for (size_t i = next++; i < points.size(); i = next++)
+                {
+                    steady_clock::time_point scheduled = start + interval * i;
+                    std::this_thread::sleep_until(scheduled);
+                    grpc::ClientContext context;
+                    Feature feature;
+                    if (!stub->GetFeature(&context, points[i], &feature).ok())
+                    {
+                        failed++;
+                    }
+                    latency_us[i] = ElapsedNs(scheduled) / 1000;
+                }
+            }));
+        }
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        PrintLatency("unary", &latency_us, ElapsedNs(start) / 1e9);
+        if (failed > 0)
+        {
+            std::printf("[lookup] unary   %zu calls failed\n", failed.load());
+        }
+    }
+
+    // 2. 双向流：一个调用，写线程按排定时间发送，当前线程按顺序接收
+    {
+        std::vector<double> latency_us;
+        latency_us.reserve(points.size());
+        grpc::ClientContext context;
+        std::shared_ptr<grpc::ClientReaderWriter<Point, Feature>> stream(stub->LookupStream(&context));
+        steady_clock::time_point start = steady_clock::now();
+        std::thread writer([&]() {
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                std::this_thread::sleep_until(start + interval * i);
+                if (!stream->Write(points[i]))
+                {
+                    break;
+                }
+            }
+            stream->WritesDone();
+        });
+
+        Feature feature;
+        while (latency_us.size() < points.size() && stream->Read(&feature))
+        {
+            latency_us.push_back(ElapsedNs(start + interval * latency_us.size()) / 1000);
+        }
+        writer.join();
+        grpc::Status status = stream->Finish();
+        PrintLatency("stream", &latency_us, ElapsedNs(start) / 1e9);
+        if (!status.ok())
+        {
+            std::printf("[lookup] stream  failed: %s\n", status.error_message().c_str());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string value;
+        if (ParseArg(argv[i], "--case", value) == 0)
+        {
+            gBenchConfig.Case = value;
+        }
+        else if (ParseArg(argv[i], "--features", value) == 0)
+        {
+            gBenchConfig.Features = std::stoul(value);
+        }
+        else if (ParseArg(argv[i], "--queries", value) == 0)
+        {
+            gBenchConfig.Queries = std::stoul(value);
+        }
+        else if (ParseArg(argv[i], "--target", value) == 0)
+        {
+            gBenchConfig.Target = value;
+        }
+        else if (ParseArg(argv[i], "--rate", value) == 0)
+        {
+            gBenchConfig.Rate = std::stoul(value);
+        }
+        else if (ParseArg(argv[i], "--lookups", value) == 0)
+        {
+            gBenchConfig.Lookups = std::stoul(value);
+        }
+        else if (ParseArg(argv[i], "--concurrency", value) == 0)
+        {
+            gBenchConfig.Concurrency = std::max<size_t>(1, std::stoul(value));
+        }
+        else
+        {
+            std::cout << "启动格式示例: " << argv[0] << " --case=all --features=1000000 --queries=200" << std::endl;
+            std::cout << "服务端用例示例: " << argv[0] << " --case=lookup --target=localhost:20202 --rate=2000 --lookups=20000 --concurrency=16" << std::endl;
+            std::cout << "建议使用 -DCMAKE_BUILD_TYPE=Release 编译后再运行" << std::endl;
+            exit(-1);
+        }
+    }
+
+    // 需要连接服务端的用例，只在指定 --target 时运行
+    if (gBenchConfig.Case == "lookup" || (gBenchConfig.Case == "all" && !gBenchConfig.Target.empty()))
+    {
+        if (gBenchConfig.Target.empty())
+        {
+            std::cout << "lookup 用例需要指定服务端地址: --target=host:port" << std::endl;
+            exit(-1);
+        }
+        BenchLookup();
+        if (gBenchConfig.Case == "lookup")
+        {
+            return 0;
+        }
+    }
+
+    std::vector<Feature> feature_list;
+    FeatureStore store;
+    GenerateFeatures(gBenchConfig.Features, &feature_list, &store);
+
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "store")
+    {
+        BenchFeatureStore(feature_list, store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "spatial")
+    {
+        BenchSpatialIndex(feature_list, store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "simd")
+    {
+        BenchRectFilter(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "nearest")
+    {
+        BenchNearest(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "wire")
+    {
+        BenchWireEncoding(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "density")
+    {
+        BenchDensity(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "polygon")
+    {
+        BenchPolygon(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "search")
+    {
+        BenchSearch(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "geohash")
+    {
+        BenchGeohash(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "scatter")
+    {
+        BenchScatter(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "load")
+    {
+        BenchLoad(store);
+    }
+    if (gBenchConfig.Case == "all" || gBenchConfig.Case == "snapshot")
+    {
+        BenchSnapshot(store);
+    }
+
+    return 0;
+}
@@ -33,12 +33,26 @@ using grpc::ClientReader;
 using grpc::ClientReaderWriter;
 using grpc::ClientWriter;
 using grpc::Status;
+using routeguide::CorridorPoint;
+using routeguide::Count;
+using routeguide::DensityGrid;
+using routeguide::DensityRequest;
 using routeguide::Point;
+using routeguide::PointBatch;
+using routeguide::Polygon;
 using routeguide::Feature;
+using routeguide::FeatureBatch;
+using routeguide::GeohashRequest;
+using routeguide::MutationResult;
+using routeguide::NearestRequest;
+using routeguide::RadiusRequest;
 using routeguide::Rectangle;
 using routeguide::RouteSummary;
 using routeguide::RouteNote;
 using routeguide::RouteGuide;
+using routeguide::ServerStats;
+using routeguide::SearchRequest;
+using routeguide::StatsRequest;
 
 Point MakePoint(long latitude, long longitude) {
   Point p;
@@ -79,6 +93,168 @@ class RouteGuideClient {
     GetOneFeature(point, &feature);
   }
 
+  void GetFeatures() {
+    PointBatch points;
+    FeatureBatch features;
+    ClientContext context;
+
+    // 用数据库中的前几个位置加上一个不存在的位置组成一批
+    for (size_t i = 0; i < feature_list_.size() && i < 5; i++) {
+      points.add_points()->CopyFrom(feature_list_[i].location());
+    }
+    points.add_points()->CopyFrom(MakePoint(0, 0));
+
+    Status status = stub_->GetFeatures(&context, points, &features);
+    if (!status.ok()) {
+      SPDLOG_ERROR("GetFeatures rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    for (const Feature& feature : features.features()) {
+      if (feature.name().empty()) {
+        SPDLOG_INFO("Found no feature at {:f}, {:f}",
+          feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+      } else {
+        SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+          feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+      }
+    }
+    SPDLOG_INFO("GetFeatures rpc succeeded, {:d} points resolved.", features.features_size());
+  }
+
+  void LookupStream() {
+    ClientContext context;
+
+    std::shared_ptr<ClientReaderWriter<Point, Feature> > stream(
+        stub_->LookupStream(&context));
+
+    // 写线程持续发送，读线程同时按顺序接收结果
+    std::vector<Point> points;
+    for (size_t i = 0; i < feature_list_.size() && i < 5; i++) {
+      points.push_back(feature_list_[i].location());
+    }
+    points.push_back(MakePoint(0, 0));
+    std::thread writer([stream, points]() {
+      for (const Point& point : points) {
+        stream->Write(point);
+      }
+      stream->WritesDone();
+    });
+
+    Feature feature;
+    int received = 0;
+    while (stream->Read(&feature)) {
+      received++;
+      if (feature.name().empty()) {
+        SPDLOG_INFO("Found no feature at {:f}, {:f}",
+          feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+      } else {
+        SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+          feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+      }
+    }
+    writer.join();
+    Status status = stream->Finish();
+    if (!status.ok()) {
+      SPDLOG_ERROR("LookupStream rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    SPDLOG_INFO("LookupStream rpc succeeded, {:d} of {:d} points resolved.", received, static_cast<int>(points.size()));
+  }
+
+  void FeaturesAlongRoute() {
+    ClientContext context;
+
+    std::shared_ptr<ClientReaderWriter<CorridorPoint, Feature> > stream(
+        stub_->FeaturesAlongRoute(&context));
+
+    // 以数据库中的前 5 个 feature 作为途经点，查找路线两侧 2 公里内的 feature
+    std::vector<CorridorPoint> route;
+    for (size_t i = 0; i < feature_list_.size() && i < 5; i++) {
+      CorridorPoint point;
+      point.mutable_location()->CopyFrom(feature_list_[i].location());
+      point.set_distance_m(2000);
+      route.push_back(point);
+    }
+    std::thread writer([stream, route]() {
+      for (const CorridorPoint& point : route) {
+        stream->Write(point);
+      }
+      stream->WritesDone();
+    });
+
+    Feature feature;
+    int received = 0;
+    while (stream->Read(&feature)) {
+      received++;
+      SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+    writer.join();
+    Status status = stream->Finish();
+    if (!status.ok()) {
+      SPDLOG_ERROR("FeaturesAlongRoute rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    SPDLOG_INFO("FeaturesAlongRoute rpc succeeded, {:d} features along {:d} route points.", received,
+      static_cast<int>(route.size()));
+  }
+
+  void MutateFeatures() {
+    // 在一个空位置新增 feature，修改名称后再删除，每一步之后都查询一次确认
+    Feature feature = MakeFeature("Demo feature", 409146139, -746188900);
+    MutationResult result;
+    {
+      ClientContext context;
+      Status status = stub_->UpsertFeature(&context, feature, &result);
+      if (!status.ok()) {
+        SPDLOG_ERROR("UpsertFeature rpc failed. error_message={}", status.error_message());
+        return;
+      }
+      SPDLOG_INFO("UpsertFeature seq={:d} existed={}", result.sequence(), result.existed());
+    }
+    Feature found;
+    GetOneFeature(feature.location(), &found);
+
+    feature.set_name("Demo feature renamed");
+    {
+      ClientContext context;
+      Status status = stub_->UpsertFeature(&context, feature, &result);
+      if (!status.ok()) {
+        SPDLOG_ERROR("UpsertFeature rpc failed. error_message={}", status.error_message());
+        return;
+      }
+      SPDLOG_INFO("UpsertFeature seq={:d} existed={}", result.sequence(), result.existed());
+    }
+    GetOneFeature(feature.location(), &found);
+
+    {
+      ClientContext context;
+      Status status = stub_->DeleteFeature(&context, feature.location(), &result);
+      if (!status.ok()) {
+        SPDLOG_ERROR("DeleteFeature rpc failed. error_message={}", status.error_message());
+        return;
+      }
+      SPDLOG_INFO("DeleteFeature seq={:d} existed={}", result.sequence(), result.existed());
+    }
+    GetOneFeature(feature.location(), &found);
+  }
+
+  void GetServerStats() {
+    StatsRequest request;
+    ServerStats stats;
+    ClientContext context;
+    Status status = stub_->GetServerStats(&context, request, &stats);
+    if (!status.ok()) {
+      SPDLOG_ERROR("GetServerStats rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    SPDLOG_INFO("Server stats: version={:d}, features={:d}, pending mutations={:d}, bloom filter {:d} bytes, fpr={:.4f}",
+      stats.snapshot_version(), stats.base_feature_count(), stats.pending_mutations(),
+      stats.bloom_filter_bytes(), stats.bloom_filter_fpr());
+    SPDLOG_INFO("ListFeatures cache: hits={:d}, misses={:d}, entries={:d}",
+      stats.list_cache_hits(), stats.list_cache_misses(), stats.list_cache_entries());
+  }
+
   void ListFeatures() {
     routeguide::Rectangle rect;
     Feature feature;
@@ -112,6 +288,168 @@ class RouteGuideClient {
     }
   }
 
+  void CountFeatures() {
+    routeguide::Rectangle rect;
+    Count count;
+    ClientContext context;
+
+    rect.mutable_lo()->set_latitude(400000000);
+    rect.mutable_lo()->set_longitude(-750000000);
+    rect.mutable_hi()->set_latitude(420000000);
+    rect.mutable_hi()->set_longitude(-730000000);
+    Status status = stub_->CountFeatures(&context, rect, &count);
+    if (!status.ok()) {
+      SPDLOG_ERROR("CountFeatures rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    SPDLOG_INFO("Counted {:d} features between 40, -75 and 42, -73", count.count());
+  }
+
+  void FeatureDensity() {
+    DensityRequest request;
+    DensityGrid grid;
+    ClientContext context;
+
+    request.mutable_rectangle()->mutable_lo()->set_latitude(400000000);
+    request.mutable_rectangle()->mutable_lo()->set_longitude(-750000000);
+    request.mutable_rectangle()->mutable_hi()->set_latitude(420000000);
+    request.mutable_rectangle()->mutable_hi()->set_longitude(-730000000);
+    request.set_cols(4);
+    request.set_rows(4);
+    Status status = stub_->FeatureDensity(&context, request, &grid);
+    if (!status.ok()) {
+      SPDLOG_ERROR("FeatureDensity rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    for (int row = 0; row < grid.rows(); row++) {
+      std::string line;
+      for (int col = 0; col < grid.cols(); col++) {
+        line += std::to_string(grid.counts(row * grid.cols() + col)) + " ";
+      }
+      SPDLOG_INFO("Density row {:d}: {}", row, line);
+    }
+  }
+
+  void ListFeaturesInPolygon() {
+    Polygon polygon;
+    Feature feature;
+    ClientContext context;
+
+    // 三角形区域，顶点依次为 (40, -75)、(41.5, -74.8)、(40.2, -73.9)
+    const int32_t vertices[][2] = {{400000000, -750000000}, {415000000, -748000000}, {402000000, -739000000}};
+    for (const auto &vertex : vertices) {
+      Point *point = polygon.add_vertices();
+      point->set_latitude(vertex[0]);
+      point->set_longitude(vertex[1]);
+    }
+    SPDLOG_INFO("Looking for features inside triangle (40, -75), (41.5, -74.8), (40.2, -73.9)");
+
+    int count = 0;
+    std::unique_ptr<ClientReader<Feature> > reader(
+        stub_->ListFeaturesInPolygon(&context, polygon));
+    while (reader->Read(&feature)) {
+      count++;
+      SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+    Status status = reader->Finish();
+    if (status.ok()) {
+      SPDLOG_INFO("ListFeaturesInPolygon rpc succeeded, {:d} features.", count);
+    } else {
+      SPDLOG_ERROR("ListFeaturesInPolygon rpc failed. error_message={}", status.error_message());
+    }
+  }
+
+  void SearchFeatures(const std::string& query, int limit) {
+    SearchRequest request;
+    FeatureBatch features;
+    ClientContext context;
+
+    request.set_query(query);
+    request.set_limit(limit);
+    Status status = stub_->SearchFeatures(&context, request, &features);
+    if (!status.ok()) {
+      SPDLOG_ERROR("SearchFeatures rpc failed. error_message={}", status.error_message());
+      return;
+    }
+    SPDLOG_INFO("Search \"{}\" returned {:d} features", query, features.features_size());
+    for (const Feature& feature : features.features()) {
+      SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+  }
+
+  void ListFeaturesByGeohash() {
+    GeohashRequest request;
+    Feature feature;
+    ClientContext context;
+
+    request.set_prefix("dr74");
+    SPDLOG_INFO("Looking for features in geohash cell dr74");
+
+    int count = 0;
+    std::unique_ptr<ClientReader<Feature> > reader(
+        stub_->ListFeaturesByGeohash(&context, request));
+    while (reader->Read(&feature)) {
+      count++;
+      SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+    Status status = reader->Finish();
+    if (status.ok()) {
+      SPDLOG_INFO("ListFeaturesByGeohash rpc succeeded, {:d} features.", count);
+    } else {
+      SPDLOG_ERROR("ListFeaturesByGeohash rpc failed. error_message={}", status.error_message());
+    }
+  }
+
+  void NearestFeatures() {
+    NearestRequest request;
+    Feature feature;
+    ClientContext context;
+
+    request.mutable_location()->CopyFrom(MakePoint(409146138, -746188906));
+    request.set_k(5);
+    request.set_max_distance_m(50000);
+    SPDLOG_INFO("Looking for the 5 nearest features within 50km of 40.9146138, -74.6188906");
+
+    std::unique_ptr<ClientReader<Feature> > reader(
+        stub_->NearestFeatures(&context, request));
+    while (reader->Read(&feature)) {
+      SPDLOG_INFO("Found nearby feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+    Status status = reader->Finish();
+    if (status.ok()) {
+      SPDLOG_INFO("NearestFeatures rpc succeeded.");
+    } else {
+      SPDLOG_ERROR("NearestFeatures rpc failed. error_message={}", status.error_message());
+    }
+  }
+
+  void FeaturesWithinRadius() {
+    RadiusRequest request;
+    Feature feature;
+    ClientContext context;
+
+    request.mutable_location()->CopyFrom(MakePoint(409146138, -746188906));
+    request.set_radius_m(10000);
+    SPDLOG_INFO("Looking for features within 10km of 40.9146138, -74.6188906");
+
+    std::unique_ptr<ClientReader<Feature> > reader(
+        stub_->FeaturesWithinRadius(&context, request));
+    while (reader->Read(&feature)) {
+      SPDLOG_INFO("Found feature called {} at {:f}, {:f}", feature.name(),
+        feature.location().latitude()/kCoordFactor_, feature.location().longitude()/kCoordFactor_);
+    }
+    Status status = reader->Finish();
+    if (status.ok()) {
+      SPDLOG_INFO("FeaturesWithinRadius rpc succeeded.");
+    } else {
+      SPDLOG_ERROR("FeaturesWithinRadius rpc failed. error_message={}", status.error_message());
+    }
+  }
+
   void RecordRoute() {
     Point point;
     RouteSummary stats;
@@ -321,9 +659,34 @@ int main(int argc, char** argv) {
     //std::cout << "-------------- GetFeature --------------" << std::endl;
     SPDLOG_INFO("-------------- GetFeature --------------");
     guide.GetFeature();
+    SPDLOG_INFO("-------------- GetFeatures --------------");
+    guide.GetFeatures();
+    SPDLOG_INFO("-------------- LookupStream --------------");
+    guide.LookupStream();
+    SPDLOG_INFO("-------------- MutateFeatures --------------");
+    guide.MutateFeatures();
+    SPDLOG_INFO("-------------- GetServerStats --------------");
+    guide.GetServerStats();
     //std::cout << "-------------- ListFeatures --------------" << std::endl;
     SPDLOG_INFO("-------------- ListFeatures --------------");
     guide.ListFeatures();
+    SPDLOG_INFO("-------------- CountFeatures --------------");
+    guide.CountFeatures();
+    SPDLOG_INFO("-------------- FeatureDensity --------------");
+    guide.FeatureDensity();
+    SPDLOG_INFO("-------------- ListFeaturesInPolygon --------------");
+    guide.ListFeaturesInPolygon();
+    SPDLOG_INFO("-------------- FeaturesAlongRoute --------------");
+    guide.FeaturesAlongRoute();
+    SPDLOG_INFO("-------------- SearchFeatures --------------");
+    guide.SearchFeatures("16", 5);
+    guide.SearchFeatures("road", 5);
+    SPDLOG_INFO("-------------- ListFeaturesByGeohash --------------");
+    guide.ListFeaturesByGeohash();
+    SPDLOG_INFO("-------------- NearestFeatures --------------");
+    guide.NearestFeatures();
+    SPDLOG_INFO("-------------- FeaturesWithinRadius --------------");
+    guide.FeaturesWithinRadius();
     //std::cout << "-------------- RecordRoute --------------" << std::endl;
     SPDLOG_INFO("-------------- RecordRoute --------------");
     if (argc < 2) {
@@ -0,0 +1,193 @@
+/**
+ * @file route_guide_dbtool.cc
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 数据库工具：把 JSON、NDJSON 或 protobuf 流数据库转换为二进制快照(.rgsnap)，以及校验快照文件
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "db_snapshot.h"
+#include "feature_db.h"
+#include "feature_store.h"
+#include "helper.h"
+
+using routeguide::FeatureDb;
+using routeguide::FeatureStore;
+using routeguide::SnapshotReader;
+using std::chrono::steady_clock;
+
+static int ParseArg(const char *sArg, const std::string &sKey, std::string &sVal)
+{
+    std::string argv = sArg;
+
+    size_t start_position = argv.find(sKey);
+    if (start_position != std::string::npos)
+    {
+        start_position += sKey.size();
+        if (argv[start_position] == ' ' || argv[start_position] == '=')
+        {
+            sVal = argv.substr(start_position + 1);
+        }
+        else
+            return -1;
+    }
+    else
+        return -1;
+
+    return 0;
+}
+
+static double ElapsedMs(steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+/**
+ * @brief 校验快照文件：检查头部、全部数据段的校验和，再按服务端的方式打开一次
+ *
+ * @return int 0 表示文件有效
+ */
+static int VerifySnapshot(const std::string &path)
+{
+    steady_clock::time_point start = steady_clock::now();
+    SnapshotReader reader;
+    if (!reader.Open(path) || !reader.Verify())
+    {
+        std::cerr << "快照文件[" << path << "]无效: " << reader.error() << std::endl;
+        return -1;
+    }
+    double verify_ms = ElapsedMs(start);
+
+    start = steady_clock::now();
+    std::shared_ptr<const FeatureDb> db = FeatureDb::OpenSnapshot(path, 1);
+    if (!db)
+    {
+        std::cerr << "快照文件[" << path << "]无法打开" << std::endl;
+        return -1;
+    }
+    std::cout << "快照文件[" << path << "]有效，" << reader.file_size() << " 字节，" << db->store().size()
+              << " 个 feature，" << db->partitions().size() << " 个分区；校验耗时 " << verify_ms << " ms，打开耗时 "
+              << ElapsedMs(start) << " ms" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief 读取数据库文件（格式见 DetectDbFormat）、构建全部索引后写入快照文件，写完后重新校验
+ *
+ * @param threads 解析线程数，0 表示使用 CPU 核数
+ * @return int 0 表示成功
+ */
+static int ConvertDb(const std::string &input, const std::string &output, size_t threads)
+{
+    steady_clock::time_point start = steady_clock::now();
+    FeatureStore store;
+    if (!routeguide::LoadDbFile(input, &store, threads))
+    {
+        std::cerr << "读取数据库文件[" << input << "]失败" << std::endl;
+        return -1;
+    }
+    if (store.empty())
+    {
+        std::cerr << "数据库文件[" << input << "]为空或解析失败" << std::endl;
+        return -1;
+    }
+    FeatureDb db(std::move(store), 1);
+    std::cout << "加载并构建索引耗时 " << ElapsedMs(start) << " ms" << std::endl;
+
+    start = steady_clock::now();
+    if (!db.SaveSnapshot(output))
+    {
+        std::cerr << "写入快照文件[" << output << "]失败" << std::endl;
+        return -1;
+    }
+    std::cout << "写入快照耗时 " << ElapsedMs(start) << " ms" << std::endl;
+
+    return VerifySnapshot(output);
+}
+
+/**
+ * @brief 解析 --threads 的值，只接受非负十进制整数（strtoul 会把 "-1" 转换为极大的值）
+ *
+ * @return bool 格式无效时返回 false
+ */
+static bool ParseThreads(const std::string &value, size_t *threads)
+{
+    if (value.empty() || value[0] < '0' || value[0] > '9')
+    {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0')
+    {
+        return false;
+    }
+    *threads = parsed;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string input;
+    std::string output;
+    std::string verify;
+    size_t threads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string value;
+        if (ParseArg(argv[i], "--input", value) == 0)
+        {
+            input = value;
+        }
+        else if (ParseArg(argv[i], "--output", value) == 0)
+        {
+            output = value;
+        }
+        else if (ParseArg(argv[i], "--verify", value) == 0)
+        {
+            verify = value;
+        }
+        else if (ParseArg(argv[i], "--threads", value) == 0 && ParseThreads(value, &threads))
+        {
+            continue;
+        }
+        else
+        {
+            // 未知参数或参数值无效，输出用法
+            input.clear();
+            verify.clear();
+            break;
+        }
+    }
+
+    if (!verify.empty())
+    {
+        return VerifySnapshot(verify) == 0 ? 0 : 1;
+    }
+    if (input.empty())
+    {
+        std::cout << "转换示例: " << argv[0] << " --input=./route_guide_db.json --output=./route_guide_db"
+                  << routeguide::kSnapshotExtension << " [--threads=0]" << std::endl;
+        std::cout << "校验示例: " << argv[0] << " --verify=./route_guide_db" << routeguide::kSnapshotExtension
+                  << std::endl;
+        return 1;
+    }
+    if (output.empty())
+    {
+        // 默认与输入文件同名，只替换扩展名
+        size_t dot = input.find_last_of('.');
+        size_t slash = input.find_last_of('/');
+        output = (dot != std::string::npos && (slash == std::string::npos || dot > slash) ? input.substr(0, dot) : input) +
+                 routeguide::kSnapshotExtension;
+    }
+    return ConvertDb(input, output, threads) == 0 ? 0 : 1;
+}
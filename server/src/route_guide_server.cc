@@ -13,9 +13,11 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 
 #include <unistd.h>
 #include <signal.h>
+#include <semaphore.h>
 
 #include <grpc/grpc.h>
 #include <grpcpp/server.h>
@@ -67,10 +69,17 @@ typedef struct STConfigInfo
     std::string ServerPort;
 
     std::string FileDBPath;
+
+    routeguide::CacheOptions ListCache;
+    routeguide::ScatterOptions ListScatter;
+
+    size_t LoadThreads;
 } STConfigInfo;
 
 static STConfigInfo gConfigInfo;
 
+static sem_t gReloadSem; // 收到 SIGUSR2 时通知后台线程重新加载数据库
+
 /**
  * @brief 解析命令行参数
  * 
@@ -100,6 +109,27 @@ static int ParseArg(const char *sArg, const std::string &sKey, std::string &sVal
     return 0;
 }
 
+/**
+ * @brief 读取非负整数配置项，GetLongValue 的结果直接转换为 size_t 时负数会变成极大的值
+ * 
+ * @param sSection 配置段名
+ * @param sKey 配置项名
+ * @param nDefault 配置项不存在时的默认值
+ * @param pValue 输出配置值
+ * @return bool 配置值为负数时返回 false
+ */
+static bool ReadSizeValue(const char *sSection, const char *sKey, long nDefault, size_t *pValue)
+{
+    long value = gSimpleIni.GetLongValue(sSection, sKey, nDefault);
+    if (value < 0)
+    {
+        std::cerr << "配置项[" << sSection << "]" << sKey << "=" << value << "无效，不能为负数" << std::endl;
+        return false;
+    }
+    *pValue = static_cast<size_t>(value);
+    return true;
+}
+
 /**
  * @brief 读取配置文件
  * 
@@ -129,6 +159,34 @@ static int ReadConfigFile()
     gConfigInfo.Env = pv;
     std::cout << "当前环境=" << gConfigInfo.Env << std::endl;
 
+    if (!ReadSizeValue("cache", "capacity", 1000000, &gConfigInfo.ListCache.capacity) ||
+        !ReadSizeValue("cache", "shards", 16, &gConfigInfo.ListCache.shards))
+    {
+        return -1;
+    }
+    pv = gSimpleIni.GetValue("cache", "admission", "always");
+    if (!routeguide::ParseCacheAdmission(pv, &gConfigInfo.ListCache.admission))
+    {
+        std::cerr << "缓存准入策略[" << pv << "]无效" << std::endl;
+        return -1;
+    }
+    std::cout << "结果缓存容量=" << gConfigInfo.ListCache.capacity << "，分片个数=" << gConfigInfo.ListCache.shards
+              << "，准入策略=" << pv << std::endl;
+
+    if (!ReadSizeValue("scatter", "threads", 0, &gConfigInfo.ListScatter.threads))
+    {
+        return -1;
+    }
+    gConfigInfo.ListScatter.min_selectivity = gSimpleIni.GetDoubleValue("scatter", "min_selectivity", 0.01);
+    std::cout << "并行查询线程数=" << gConfigInfo.ListScatter.threads << "，最低命中比例="
+              << gConfigInfo.ListScatter.min_selectivity << std::endl;
+
+    if (!ReadSizeValue("load", "threads", 0, &gConfigInfo.LoadThreads))
+    {
+        return -1;
+    }
+    std::cout << "数据库解析线程数=" << gConfigInfo.LoadThreads << std::endl;
+
     return 0;
 }
 
@@ -160,16 +218,50 @@ static void HandleSignal(int signum)
     modify_log_level(gConfigInfo.LogLevel);
 }
 
+/**
+ * @brief 处理 SIGUSR2 信号的信号处理回调函数。
+ * 信号处理函数中只能调用异步信号安全的函数，这里只唤醒后台线程，由后台线程完成数据库重新加载
+ * 
+ * @param signum 信号
+ */
+static void HandleReloadSignal(int signum)
+{
+    sem_post(&gReloadSem);
+}
+
+/**
+ * @brief 数据库热加载线程：等待 SIGUSR2 通知，重新读取 --db_path 指定的文件并构建新快照
+ * 
+ * @param service 服务实现
+ */
+static void ReloadDbLoop(routeguide::RouteGuideImpl *service)
+{
+    while (true)
+    {
+        if (sem_wait(&gReloadSem) != 0)
+        {
+            continue; // 被信号打断
+        }
+        SPDLOG_INFO("开始重新加载数据库: {}", gConfigInfo.FileDBPath);
+        service->Reload(gConfigInfo.FileDBPath);
+    }
+}
+
 /**
  * @brief 启动 gRPC 服务器
  * 
  * @param server_port 服务监控端口
- * @param db_path 地理位置信息文件数据库
+ * @param db_path 地理位置信息文件数据库，JSON、NDJSON、protobuf 流或二进制快照(.rgsnap)
+ * @param list_cache ListFeatures 结果缓存配置
+ * @param list_scatter ListFeatures 大范围查询的并行配置
+ * @param load_threads 解析 JSON 数据库的线程数
  */
-void RunServer(const std::string &server_port, const std::string &db_path)
+void RunServer(const std::string &server_port, const std::string &db_path,
+               const routeguide::CacheOptions &list_cache, const routeguide::ScatterOptions &list_scatter,
+               size_t load_threads)
 {
     std::string server_address("0.0.0.0:"+server_port);
-    routeguide::RouteGuideImpl service(db_path);
+    routeguide::RouteGuideImpl service(db_path, list_cache, list_scatter, load_threads);
 
     ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
@@ -188,6 +280,10 @@ void RunServer(const std::string &server_port, const std::string &db_path)
     //std::cout << "Server listening on " << server_address << std::endl;
     SPDLOG_INFO("服务启动成功，监听端口为 {}", server_address);
 
+    // 数据库热加载线程，随进程退出
+    std::thread reload_thread(ReloadDbLoop, &service);
+    reload_thread.detach();
+
     server->Wait();
 }
 
@@ -236,14 +332,22 @@ int main(int argc, char **argv)
         SPDLOG_ERROR("设置信号处理函数发生异常");
         exit(-1);
     }
+
+    //设置信号处理函数，专门处理 SIGUSR2，用于热加载 --db_path 指定的数据库文件
+    sem_init(&gReloadSem, 0, 0);
+    sa.sa_handler = HandleReloadSignal;
+    if (sigaction(SIGUSR2, &sa, NULL) == -1)
+    {
+        SPDLOG_ERROR("设置信号处理函数发生异常");
+        exit(-1);
+    }
         
     //初始化数据库连接池
     //TODO
 
-    std::string db = routeguide::GetDbFileContent(gConfigInfo.FileDBPath);
-
     //启动服务
-    RunServer(gConfigInfo.ServerPort, db);
+    RunServer(gConfigInfo.ServerPort, gConfigInfo.FileDBPath, gConfigInfo.ListCache, gConfigInfo.ListScatter,
+              gConfigInfo.LoadThreads);
 
     //退出日志框架
     exit_logger();
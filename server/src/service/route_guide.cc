@@ -3,8 +3,13 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_set>
 
 #include "route_guide.h"
 
@@ -14,94 +19,160 @@ using grpc::ServerReaderWriter;
 using grpc::ServerWriter;
 using grpc::Status;
 
+using routeguide::CorridorPoint;
+using routeguide::Count;
+using routeguide::DensityGrid;
+using routeguide::DensityRequest;
 using routeguide::Feature;
+using routeguide::FeatureBatch;
+using routeguide::GeohashRequest;
+using routeguide::MutationResult;
+using routeguide::NearestRequest;
 using routeguide::Point;
+using routeguide::PointBatch;
+using routeguide::Polygon;
+using routeguide::RadiusRequest;
 using routeguide::Rectangle;
 using routeguide::RouteGuide;
 using routeguide::RouteNote;
 using routeguide::RouteSummary;
+using routeguide::SearchRequest;
+using routeguide::ServerStats;
+using routeguide::StatsRequest;
 
 using std::chrono::system_clock;
 
 namespace routeguide
 {
+    const size_t RouteGuideImpl::kMinScatterRows;
+    const uint32_t RouteGuideImpl::kMaxDensityCells;
+    const int RouteGuideImpl::kMaxPolygonVertices;
+    const int RouteGuideImpl::kDefaultSearchLimit;
+    const int RouteGuideImpl::kMaxSearchLimit;
 
-    float ConvertToRadians(float num)
+    std::string GetFeatureName(const Point &point, const FeatureSnapshot &snapshot)
     {
-        return num * 3.1415926 / 180;
-    }
-
-    // The formula is based on http://mathforum.org/library/drmath/view/51879.html
-    float GetDistance(const Point &start, const Point &end)
-    {
-        const float kCoordFactor = 10000000.0;
-        float lat_1 = start.latitude() / kCoordFactor;
-        float lat_2 = end.latitude() / kCoordFactor;
-        float lon_1 = start.longitude() / kCoordFactor;
-        float lon_2 = end.longitude() / kCoordFactor;
-        float lat_rad_1 = ConvertToRadians(lat_1);
-        float lat_rad_2 = ConvertToRadians(lat_2);
-        float delta_lat_rad = ConvertToRadians(lat_2 - lat_1);
-        float delta_lon_rad = ConvertToRadians(lon_2 - lon_1);
-
-        float a = pow(sin(delta_lat_rad / 2), 2) + cos(lat_rad_1) * cos(lat_rad_2) *
-                                                       pow(sin(delta_lon_rad / 2), 2);
-        float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-        int R = 6371000; // metres
-
-        return R * c;
-    }
-
-    std::string GetFeatureName(const Point &point,
-                               const std::vector<Feature> &feature_list)
-    {
-        for (const Feature &f : feature_list)
+        Feature feature;
+        if (snapshot.Lookup(point, &feature))
         {
-            if (f.location().latitude() == point.latitude() &&
-                f.location().longitude() == point.longitude())
-            {
-                //std::cout << "found. name=" << f.name() << std::endl;
-                SPDLOG_INFO("found. name={}", f.name());
-                return f.name();
-            }
+            //std::cout << "found. name=" << f.name() << std::endl;
+            SPDLOG_INFO("found. name={}", feature.name());
+            return feature.name();
         }
         return "";
     }
 
+    /**
+     * @brief 把 rectangle 的两个角点归一化为包围盒
+     *
+     */
+    BoundingBox ToBoundingBox(const Rectangle &rectangle)
+    {
+        const Point &lo = rectangle.lo();
+        const Point &hi = rectangle.hi();
+        BoundingBox box;
+        box.min_lon = (std::min)(lo.longitude(), hi.longitude());
+        box.max_lon = (std::max)(lo.longitude(), hi.longitude());
+        box.max_lat = (std::max)(lo.latitude(), hi.latitude());
+        box.min_lat = (std::min)(lo.latitude(), hi.latitude());
+        return box;
+    }
+
     Status RouteGuideImpl::GetFeature(ServerContext *context, const Point *point,
                       Feature *feature)
     {
         //std::cout << "latitude=" << point->latitude() << ",longitude=" << point->longitude() << std::endl;
         SPDLOG_INFO("latitude={:d},longitude={:d}", point->latitude(), point->longitude());
-        feature->set_name(GetFeatureName(*point, feature_list_));
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        feature->set_name(GetFeatureName(*point, *db));
         feature->mutable_location()->CopyFrom(*point);
         return Status::OK;
         //return grpc::Status(grpc::StatusCode::NOT_FOUND, "test-not-found");
     }
 
-    Status RouteGuideImpl::ListFeatures(ServerContext *context,
-                        const routeguide::Rectangle *rectangle,
-                        ServerWriter<Feature> *writer)
+    Status RouteGuideImpl::ListFeaturesEncoded(ServerContext *context,
+                                               grpc::ServerSplitStreamer<Rectangle, grpc::ByteBuffer> *stream)
     {
-        auto lo = rectangle->lo();
-        auto hi = rectangle->hi();
-        long left = (std::min)(lo.longitude(), hi.longitude());
-        long right = (std::max)(lo.longitude(), hi.longitude());
-        long top = (std::max)(lo.latitude(), hi.latitude());
-        long bottom = (std::min)(lo.latitude(), hi.latitude());
-        for (const Feature &f : feature_list_)
+        routeguide::Rectangle rectangle;
+        if (!stream->Read(&rectangle))
         {
-            if (f.location().longitude() >= left &&
-                f.location().longitude() <= right &&
-                f.location().latitude() >= bottom &&
-                f.location().latitude() <= top)
+            return Status(grpc::StatusCode::INTERNAL, "failed to read request");
+        }
+        BoundingBox box = ToBoundingBox(rectangle);
+
+        // 整个流都使用同一个快照，期间发生热加载也不受影响
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureDb &base = db->base();
+        auto write_rows = [&base, stream](const std::vector<uint32_t> &rows) {
+            for (uint32_t row : rows)
             {
-                writer->Write(f);
+                grpc::Slice slice(base.wire_data(row), base.wire_size(row));
+                grpc::ByteBuffer buffer(&slice, 1);
+                stream->Write(buffer);
+            }
+        };
+        auto write_encoded = [stream](const std::vector<std::string> &features) {
+            for (const std::string &encoded : features)
+            {
+                grpc::Slice slice(encoded);
+                grpc::ByteBuffer buffer(&slice, 1);
+                stream->Write(buffer);
             }
+        };
+
+        ListCacheKey key = {box, db->version(), base.version()};
+        std::shared_ptr<const ListCacheValue> result;
+        if (list_cache_.enabled() && list_cache_.Get(key, &result))
+        {
+            write_rows(result->rows);
+            write_encoded(result->delta_features);
+            return Status::OK;
+        }
+
+        std::shared_ptr<ListCacheValue> value = std::make_shared<ListCacheValue>();
+        if (scatter_pool_ && base.partitions().size() > 1 &&
+            base.spatial_index().Count(box) >=
+                std::max<double>(kMinScatterRows, scatter_.min_selectivity * base.store().size()))
+        {
+            // 大范围查询：各分区的结果一完成就发送，同时汇总用于缓存
+            db->ScatterQuery(box, scatter_pool_.get(),
+                             [&value, &write_rows](const std::vector<uint32_t> &rows) {
+                                 write_rows(rows);
+                                 value->rows.insert(value->rows.end(), rows.begin(), rows.end());
+                             });
+        }
+        else
+        {
+            base.spatial_index().Query(box, &value->rows);
+            if (!db->delta().empty())
+            {
+                value->rows.erase(std::remove_if(value->rows.begin(), value->rows.end(),
+                                                 [&db](uint32_t row) { return db->Hidden(row); }),
+                                  value->rows.end());
+            }
+            write_rows(value->rows);
+        }
+
+        Feature f;
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (!entry.deleted && box.Contains(entry.latitude, entry.longitude))
+            {
+                entry.ToFeature(&f);
+                value->delta_features.push_back(f.SerializeAsString());
+            }
+        }
+        write_encoded(value->delta_features);
+
+        if (list_cache_.enabled())
+        {
+            list_cache_.Put(key, value, value->rows.size() + value->delta_features.size() + 1);
         }
         return Status::OK;
     }
 
+
     Status RouteGuideImpl::RecordRoute(ServerContext *context, ServerReader<Point> *reader,
                        RouteSummary *summary)
     {
@@ -111,11 +182,12 @@ namespace routeguide
         float distance = 0.0;
         Point previous;
 
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
         system_clock::time_point start_time = system_clock::now();
         while (reader->Read(&point))
         {
             point_count++;
-            if (!GetFeatureName(point, feature_list_).empty())
+            if (!GetFeatureName(point, *db).empty())
             {
                 feature_count++;
             }
@@ -157,4 +229,636 @@ namespace routeguide
         return Status::OK;
     }
 
-} // namespace routeguide
\ No newline at end of file
+    Status RouteGuideImpl::NearestFeatures(ServerContext *context, const NearestRequest *request,
+                                           ServerWriter<Feature> *writer)
+    {
+        if (request->k() <= 0 || request->max_distance_m() < 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "k must be positive and max_distance_m must not be negative");
+        }
+
+        int32_t lat = request->location().latitude();
+        int32_t lon = request->location().longitude();
+        double max_distance = request->max_distance_m() > 0 ? request->max_distance_m()
+                                                            : std::numeric_limits<double>::infinity();
+
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        size_t k = static_cast<size_t>(request->k());
+        std::vector<uint32_t> rows;
+        std::vector<double> distances;
+        // 只返回有名称的 feature，被过滤的行不计入 k
+        const FeatureStore &store = db->base().store();
+        std::function<bool(uint32_t)> filter = [&store](uint32_t row) { return store.name_size(row) > 0; };
+        if (!db->delta().empty())
+        {
+            filter = [&db, &store](uint32_t row) { return store.name_size(row) > 0 && !db->Hidden(row); };
+        }
+        db->base().spatial_index().Nearest(
+            k, max_distance,
+            [lat, lon](const BoundingBox &box) { return GetDistanceLowerBound(lat, lon, box); },
+            [lat, lon](int32_t feature_lat, int32_t feature_lon) {
+                return static_cast<double>(GetDistance(lat, lon, feature_lat, feature_lon));
+            },
+            &rows, &distances, filter);
+
+        // 增量层中的新增和修改按距离与主库结果归并，取前 k 个
+        typedef std::pair<double, const DeltaEntry *> DeltaHit;
+        std::vector<DeltaHit> delta_hits;
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (entry.deleted || entry.name.empty())
+            {
+                continue;
+            }
+            double distance = GetDistance(lat, lon, entry.latitude, entry.longitude);
+            if (distance <= max_distance)
+            {
+                delta_hits.push_back(DeltaHit(distance, &entry));
+            }
+        }
+        std::sort(delta_hits.begin(), delta_hits.end(),
+                  [](const DeltaHit &a, const DeltaHit &b) { return a.first < b.first; });
+
+        Feature f;
+        size_t base_pos = 0;
+        size_t delta_pos = 0;
+        for (size_t written = 0; written < k; written++)
+        {
+            if (base_pos < rows.size() &&
+                (delta_pos == delta_hits.size() || distances[base_pos] <= delta_hits[delta_pos].first))
+            {
+                store.ToFeature(rows[base_pos++], &f);
+            }
+            else if (delta_pos < delta_hits.size())
+            {
+                delta_hits[delta_pos++].second->ToFeature(&f);
+            }
+            else
+            {
+                break;
+            }
+            writer->Write(f);
+        }
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::FeaturesWithinRadius(ServerContext *context, const RadiusRequest *request,
+                                                ServerWriter<Feature> *writer)
+    {
+        if (request->radius_m() <= 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "radius_m must be positive");
+        }
+
+        int32_t lat = request->location().latitude();
+        int32_t lon = request->location().longitude();
+        if (!IsValidLocation(lat, lon))
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "location out of range");
+        }
+
+        // 先用包围盒在 R 树中筛选候选，再用预先算好的单位向量判断，边界附近的点用 double 精确判断
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        std::vector<BoundingBox> boxes;
+        GetRadiusBoundingBoxes(lat, lon, request->radius_m(), &boxes);
+        std::vector<uint32_t> rows;
+        for (const BoundingBox &box : boxes)
+        {
+            db->base().spatial_index().Query(box, &rows);
+        }
+
+        RadiusFilter filter(lat, lon, request->radius_m());
+        const FeatureStore &store = db->base().store();
+        Feature f;
+        for (uint32_t row : rows)
+        {
+            if (!db->Hidden(row) &&
+                filter.Contains(store.latitude(row), store.longitude(row), db->base().unit_vectors()[row]))
+            {
+                store.ToFeature(row, &f);
+                writer->Write(f);
+            }
+        }
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (!entry.deleted &&
+                filter.Contains(entry.latitude, entry.longitude, ToUnitVector(entry.latitude, entry.longitude)))
+            {
+                entry.ToFeature(&f);
+                writer->Write(f);
+            }
+        }
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::GetFeatures(ServerContext *context, const PointBatch *points,
+                                       FeatureBatch *features)
+    {
+        SPDLOG_INFO("GetFeatures batch size={:d}", points->points_size());
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        features->mutable_features()->Reserve(points->points_size());
+        int found = 0;
+        for (const Point &point : points->points())
+        {
+            if (db->Lookup(point, features->add_features()))
+            {
+                found++;
+            }
+        }
+        SPDLOG_DEBUG("GetFeatures found {:d} of {:d}", found, points->points_size());
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::LookupStream(ServerContext *context,
+                                        ServerReaderWriter<Feature, Point> *stream)
+    {
+        // 待发送队列上限，客户端读得慢时阻塞读取端，避免结果无限堆积
+        const size_t kMaxPending = 1024;
+
+        std::mutex mu;
+        std::condition_variable ready_cv;
+        std::condition_variable space_cv;
+        std::vector<Feature> pending;
+        bool reads_done = false;
+        bool write_failed = false;
+
+        // 写线程：每次取走队列中已有的全部结果，除最后一条外都设置 buffer_hint，合并成更少的帧发送
+        std::thread writer([&]() {
+            std::vector<Feature> batch;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mu);
+                    ready_cv.wait(lock, [&]() { return !pending.empty() || reads_done; });
+                    if (pending.empty())
+                    {
+                        return;
+                    }
+                    batch.swap(pending);
+                }
+                space_cv.notify_one();
+
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    grpc::WriteOptions options;
+                    if (i + 1 < batch.size())
+                    {
+                        options.set_buffer_hint();
+                    }
+                    if (!stream->Write(batch[i], options))
+                    {
+                        std::unique_lock<std::mutex> lock(mu);
+                        write_failed = true;
+                        space_cv.notify_one();
+                        return;
+                    }
+                }
+                batch.clear();
+            }
+        });
+
+        // 每次查找都取当前快照，长连接在热加载后也能查到新数据
+        Point point;
+        uint64_t lookups = 0;
+        while (stream->Read(&point))
+        {
+            Feature feature;
+            db_.Load()->Lookup(point, &feature);
+            lookups++;
+
+            std::unique_lock<std::mutex> lock(mu);
+            space_cv.wait(lock, [&]() { return pending.size() < kMaxPending || write_failed; });
+            if (write_failed)
+            {
+                break;
+            }
+            pending.push_back(std::move(feature));
+            lock.unlock();
+            ready_cv.notify_one();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            reads_done = true;
+        }
+        ready_cv.notify_one();
+        writer.join();
+
+        SPDLOG_INFO("LookupStream finished, {:d} lookups.", lookups);
+        if (write_failed)
+        {
+            return Status(grpc::StatusCode::UNAVAILABLE, "failed to write lookup result");
+        }
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::UpsertFeature(ServerContext *context, const Feature *feature,
+                                         MutationResult *result)
+    {
+        const Point &location = feature->location();
+        if (feature->name().empty())
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "name must not be empty");
+        }
+        if (!IsValidLocation(location.latitude(), location.longitude()))
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "location out of range");
+        }
+
+        bool existed = false;
+        uint64_t seq = db_.Upsert(location.latitude(), location.longitude(), feature->name(), &existed);
+        SPDLOG_INFO("UpsertFeature seq={:d} latitude={:d},longitude={:d} existed={}", seq,
+                    location.latitude(), location.longitude(), existed);
+        result->set_sequence(seq);
+        result->set_existed(existed);
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::DeleteFeature(ServerContext *context, const Point *point,
+                                         MutationResult *result)
+    {
+        bool existed = false;
+        uint64_t seq = db_.Delete(point->latitude(), point->longitude(), &existed);
+        SPDLOG_INFO("DeleteFeature seq={:d} latitude={:d},longitude={:d} existed={}", seq,
+                    point->latitude(), point->longitude(), existed);
+        result->set_sequence(seq);
+        result->set_existed(existed);
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::GetServerStats(ServerContext *context, const StatsRequest *request,
+                                          ServerStats *stats)
+    {
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        stats->set_snapshot_version(db->version());
+        stats->set_base_feature_count(db->base().store().size());
+        stats->set_pending_mutations(db->delta().size());
+        stats->set_bloom_filter_bytes(db->base().bloom_filter().MemoryUsage());
+        stats->set_bloom_filter_fpr(db->base().bloom_false_positive_rate());
+        stats->set_list_cache_hits(list_cache_.hits());
+        stats->set_list_cache_misses(list_cache_.misses());
+        stats->set_list_cache_entries(list_cache_.entries());
+        return Status::OK;
+    }
+
+    size_t RouteGuideImpl::ListCacheKeyHash::operator()(const ListCacheKey &key) const
+    {
+        uint64_t hash = key.snapshot_version * 0x9e3779b97f4a7c15ULL + key.base_version;
+        const int32_t fields[] = {key.box.min_lat, key.box.max_lat, key.box.min_lon, key.box.max_lon};
+        for (int32_t field : fields)
+        {
+            hash = (hash ^ static_cast<uint32_t>(field)) * 0x100000001b3ULL;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
+
+    Status RouteGuideImpl::CountFeatures(ServerContext *context, const Rectangle *rectangle,
+                                         Count *count)
+    {
+        BoundingBox box = ToBoundingBox(*rectangle);
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const SpatialIndex &index = db->base().spatial_index();
+        int64_t total = index.Count(box);
+
+        // 增量层中落在矩形内的位置：主库中该位置上的行都已被覆盖，减去后再加上未删除的记录
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (!box.Contains(entry.latitude, entry.longitude))
+            {
+                continue;
+            }
+            BoundingBox point = {entry.latitude, entry.latitude, entry.longitude, entry.longitude};
+            total -= index.Count(point);
+            if (!entry.deleted)
+            {
+                total++;
+            }
+        }
+        count->set_count(total);
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::FeatureDensity(ServerContext *context, const DensityRequest *request,
+                                          DensityGrid *grid)
+    {
+        if (request->cols() <= 0 || request->rows() <= 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "cols and rows must be positive");
+        }
+        if (static_cast<uint64_t>(request->cols()) * request->rows() > kMaxDensityCells)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "cols * rows exceeds the maximum grid size");
+        }
+
+        GridLayout layout;
+        layout.box = ToBoundingBox(request->rectangle());
+        layout.cols = request->cols();
+        layout.rows = request->rows();
+
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureStore &store = db->base().store();
+        // 只扫描与矩形相交的分区，在 ListFeatures 的并行线程池中执行
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (const FeaturePartition &partition : db->base().partitions())
+        {
+            if (partition.bounds.Intersects(layout.box))
+            {
+                ranges.push_back(std::make_pair(partition.begin, partition.end));
+            }
+        }
+        std::vector<uint32_t> counts;
+        CountDensity(store.latitudes(), store.longitudes(), ranges, layout, scatter_pool_.get(), &counts);
+
+        // 与 CountFeatures 相同：减去主库中被增量层覆盖的行，再加上未删除的记录
+        const SpatialIndex &index = db->base().spatial_index();
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (!layout.box.Contains(entry.latitude, entry.longitude))
+            {
+                continue;
+            }
+            size_t cell = layout.Cell(entry.latitude, entry.longitude);
+            BoundingBox point = {entry.latitude, entry.latitude, entry.longitude, entry.longitude};
+            counts[cell] -= static_cast<uint32_t>(index.Count(point));
+            if (!entry.deleted)
+            {
+                counts[cell]++;
+            }
+        }
+
+        grid->set_cols(layout.cols);
+        grid->set_rows(layout.rows);
+        grid->mutable_counts()->Reserve(static_cast<int>(counts.size()));
+        grid->mutable_counts()->Add(counts.begin(), counts.end());
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::FeaturesAlongRoute(ServerContext *context,
+                                              ServerReaderWriter<Feature, CorridorPoint> *stream)
+    {
+        CorridorPoint point;
+        if (!stream->Read(&point))
+        {
+            return Status::OK;
+        }
+        double distance = point.distance_m();
+        if (distance <= 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "distance_m must be positive");
+        }
+
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureStore &store = db->base().store();
+        std::unordered_set<uint32_t> sent_rows;
+        std::unordered_set<uint64_t> sent_delta;
+        std::vector<BoundingBox> boxes;
+        std::vector<uint32_t> rows;
+        Feature f;
+
+        // 第一个点与自身组成退化线段，只有一个点的路线即为以该点为圆心的圆
+        Point previous = point.location();
+        do
+        {
+            const Point &current = point.location();
+            if (!IsValidLocation(current.latitude(), current.longitude()))
+            {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "location out of range");
+            }
+
+            boxes.clear();
+            rows.clear();
+            GetSegmentBoundingBoxes(previous.latitude(), previous.longitude(), current.latitude(),
+                                    current.longitude(), distance, &boxes);
+            for (const BoundingBox &box : boxes)
+            {
+                db->base().spatial_index().Query(box, &rows);
+            }
+            for (uint32_t row : rows)
+            {
+                if (sent_rows.count(row) > 0 || db->Hidden(row) ||
+                    GetDistanceToSegment(store.latitude(row), store.longitude(row), previous.latitude(),
+                                         previous.longitude(), current.latitude(), current.longitude()) > distance)
+                {
+                    continue;
+                }
+                sent_rows.insert(row);
+                store.ToFeature(row, &f);
+                stream->Write(f);
+            }
+
+            for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+            {
+                const DeltaEntry &entry = item.second;
+                if (entry.deleted || sent_delta.count(item.first) > 0 ||
+                    GetDistanceToSegment(entry.latitude, entry.longitude, previous.latitude(), previous.longitude(),
+                                         current.latitude(), current.longitude()) > distance)
+                {
+                    continue;
+                }
+                sent_delta.insert(item.first);
+                entry.ToFeature(&f);
+                stream->Write(f);
+            }
+            previous = current;
+        } while (stream->Read(&point));
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::SearchFeatures(ServerContext *context, const SearchRequest *request,
+                                          FeatureBatch *features)
+    {
+        if (request->query().empty())
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "query must not be empty");
+        }
+        if (request->limit() < 0 || request->limit() > kMaxSearchLimit)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "limit out of range");
+        }
+        size_t limit = request->limit() > 0 ? request->limit() : kDefaultSearchLimit;
+
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureStore &store = db->base().store();
+        const NameIndex &index = db->base().name_index();
+        std::string needle = NameIndex::Fold(request->query().data(), request->query().size());
+
+        // 增量层中的匹配记录，按前缀匹配和子串匹配分开
+        std::vector<const DeltaEntry *> delta_prefix;
+        std::vector<const DeltaEntry *> delta_substring;
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (entry.deleted)
+            {
+                continue;
+            }
+            std::string name = NameIndex::Fold(entry.name.data(), entry.name.size());
+            if (name.compare(0, needle.size(), needle) == 0)
+            {
+                delta_prefix.push_back(&entry);
+            }
+            else if (needle.size() >= NameIndex::kGramSize && name.find(needle) != std::string::npos)
+            {
+                delta_substring.push_back(&entry);
+            }
+        }
+
+        std::sort(delta_substring.begin(), delta_substring.end(),
+                  [](const DeltaEntry *a, const DeltaEntry *b) { return a->seq < b->seq; });
+
+        // 1. 前缀匹配：主库结果与增量层结果合并后按名称排序，取前 limit 个
+        std::vector<uint32_t> rows;
+        index.FindPrefix(request->query(), limit, [&db](uint32_t row) { return !db->Hidden(row); }, &rows);
+        std::vector<std::pair<std::string, Feature>> prefix_hits;
+        Feature f;
+        for (uint32_t row : rows)
+        {
+            store.ToFeature(row, &f);
+            prefix_hits.push_back(std::make_pair(NameIndex::Fold(f.name().data(), f.name().size()), f));
+        }
+        for (const DeltaEntry *entry : delta_prefix)
+        {
+            entry->ToFeature(&f);
+            prefix_hits.push_back(std::make_pair(NameIndex::Fold(f.name().data(), f.name().size()), f));
+        }
+        std::stable_sort(prefix_hits.begin(), prefix_hits.end(),
+                         [](const std::pair<std::string, Feature> &a, const std::pair<std::string, Feature> &b) {
+                             return a.first < b.first;
+                         });
+        for (size_t i = 0; i < prefix_hits.size() && i < limit; i++)
+        {
+            features->add_features()->Swap(&prefix_hits[i].second);
+        }
+
+        // 2. 子串匹配：排除已经作为前缀匹配返回过的 feature
+        size_t remaining = limit - features->features_size();
+        if (remaining > 0)
+        {
+            rows.clear();
+            index.FindSubstring(request->query(), remaining,
+                                [&](uint32_t row) {
+                                    return !db->Hidden(row) &&
+                                           (store.name_size(row) < needle.size() ||
+                                            NameIndex::Fold(store.name_data(row), needle.size()) != needle);
+                                },
+                                &rows);
+            for (uint32_t row : rows)
+            {
+                store.ToFeature(row, features->add_features());
+            }
+            for (size_t i = 0; i < delta_substring.size() && static_cast<size_t>(features->features_size()) < limit; i++)
+            {
+                delta_substring[i]->ToFeature(features->add_features());
+            }
+        }
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::ListFeaturesByGeohash(ServerContext *context, const GeohashRequest *request,
+                                                 ServerWriter<Feature> *writer)
+    {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        if (!GetGeohashRange(request->prefix(), &lo, &hi))
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "invalid geohash prefix");
+        }
+
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureStore &store = db->base().store();
+        size_t begin = 0;
+        size_t end = 0;
+        db->base().FindGeohashRange(lo, hi, &begin, &end);
+
+        Feature f;
+        for (size_t row = begin; row < end; row++)
+        {
+            if (!db->Hidden(row))
+            {
+                store.ToFeature(row, &f);
+                writer->Write(f);
+            }
+        }
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            uint64_t key = GetGeohashKey(entry.latitude, entry.longitude);
+            if (!entry.deleted && key >= lo && key < hi)
+            {
+                entry.ToFeature(&f);
+                writer->Write(f);
+            }
+        }
+        return Status::OK;
+    }
+
+    Status RouteGuideImpl::ListFeaturesInPolygon(ServerContext *context, const Polygon *polygon,
+                                                 ServerWriter<Feature> *writer)
+    {
+        int n = polygon->vertices_size();
+        if (n < 3)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "polygon must have at least 3 vertices");
+        }
+        if (n > kMaxPolygonVertices)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "polygon has too many vertices");
+        }
+        std::vector<int32_t> vertex_lat(n);
+        std::vector<int32_t> vertex_lon(n);
+        for (int i = 0; i < n; i++)
+        {
+            const Point &vertex = polygon->vertices(i);
+            if (!IsValidLocation(vertex.latitude(), vertex.longitude()))
+            {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "vertex out of range");
+            }
+            vertex_lat[i] = vertex.latitude();
+            vertex_lon[i] = vertex.longitude();
+        }
+        PolygonIndex index;
+        index.Build(vertex_lat.data(), vertex_lon.data(), n);
+
+        // 包围盒内的候选行先收集为连续的经纬度列，再批量判断
+        std::shared_ptr<const FeatureSnapshot> db = db_.Load();
+        const FeatureStore &store = db->base().store();
+        std::vector<uint32_t> rows;
+        db->base().spatial_index().Query(index.bounds(), &rows);
+        std::vector<int32_t> lat;
+        std::vector<int32_t> lon;
+        lat.reserve(rows.size());
+        lon.reserve(rows.size());
+        for (uint32_t row : rows)
+        {
+            lat.push_back(store.latitude(row));
+            lon.push_back(store.longitude(row));
+        }
+        std::vector<uint32_t> hits;
+        index.Filter(lat.data(), lon.data(), rows.size(), &hits);
+
+        Feature f;
+        for (uint32_t hit : hits)
+        {
+            if (!db->Hidden(rows[hit]))
+            {
+                store.ToFeature(rows[hit], &f);
+                writer->Write(f);
+            }
+        }
+        for (const FeatureDelta::EntryMap::value_type &item : db->delta().entries())
+        {
+            const DeltaEntry &entry = item.second;
+            if (!entry.deleted && index.Contains(entry.latitude, entry.longitude))
+            {
+                entry.ToFeature(&f);
+                writer->Write(f);
+            }
+        }
+        return Status::OK;
+    }
+
+} // namespace routeguide
@@ -16,9 +16,15 @@
 #include <grpc/grpc.h>
 #include <grpcpp/server_context.h>
 #include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/byte_buffer.h>
 
 #include "userlog.h"
 #include "helper.h"
+#include "density_grid.h"
+#include "live_feature_db.h"
+#include "lru_cache.h"
+#include "polygon_index.h"
+#include "thread_pool.h"
 #include "log_interceptor_server.h"
 
 #include "route_guide.grpc.pb.h"
@@ -29,15 +35,41 @@ using grpc::ServerReaderWriter;
 using grpc::ServerWriter;
 using grpc::Status;
 
+using routeguide::CorridorPoint;
+using routeguide::Count;
+using routeguide::DensityGrid;
+using routeguide::DensityRequest;
 using routeguide::Feature;
+using routeguide::FeatureBatch;
+using routeguide::GeohashRequest;
+using routeguide::MutationResult;
+using routeguide::NearestRequest;
 using routeguide::Point;
+using routeguide::PointBatch;
+using routeguide::Polygon;
+using routeguide::RadiusRequest;
 using routeguide::Rectangle;
 using routeguide::RouteGuide;
 using routeguide::RouteNote;
 using routeguide::RouteSummary;
+using routeguide::SearchRequest;
+using routeguide::ServerStats;
+using routeguide::StatsRequest;
 
 namespace routeguide
 {
+    /**
+     * @brief ListFeatures 大范围查询的并行配置
+     *
+     */
+    struct ScatterOptions
+    {
+        size_t threads;         // 工作线程数，0 表示使用 CPU 核数，1 表示不并行
+        double min_selectivity; // 命中行数占总行数的比例不低于该值时才分发到各分区并行查询
+
+        ScatterOptions() : threads(0), min_selectivity(0.01) {}
+    };
+
     /**
      * @brief RouteGuideImpl 实现 protobuf 中定义的服务以及rpc接口
      * 
@@ -48,11 +80,45 @@ namespace routeguide
         /**
          * @brief Construct a new Route Guide Impl object
          * 
-         * @param db 保存地理位置信息的文件数据库
+         * @param db_path 保存地理位置信息的文件数据库，JSON、NDJSON、protobuf 流或二进制快照(.rgsnap)
+         * @param list_cache ListFeatures 结果缓存配置，容量为 0 时不启用缓存
+         * @param scatter ListFeatures 大范围查询的并行配置
+         * @param load_threads 加载和重新加载数据库时解析 JSON 的线程数，0 表示使用 CPU 核数
+         */
+        RouteGuideImpl(const std::string &db_path, const CacheOptions &list_cache = CacheOptions(),
+                       const ScatterOptions &scatter = ScatterOptions(), size_t load_threads = 0)
+            : db_(db_path, load_threads), list_cache_(list_cache), scatter_(scatter)
+        {
+            if (scatter_.threads != 1)
+            {
+                scatter_pool_.reset(new ThreadPool(scatter_.threads));
+            }
+
+            // ListFeatures 改为拆分流(split streaming)处理，直接发送预编码的 ByteBuffer，跳过 protobuf 序列化
+            MarkMethodStreamed(kListFeaturesMethodIndex,
+                               new grpc::internal::SplitServerStreamingHandler<Rectangle, grpc::ByteBuffer>(
+                                   [this](ServerContext *context,
+                                          grpc::ServerSplitStreamer<Rectangle, grpc::ByteBuffer> *stream) {
+                                       return this->ListFeaturesEncoded(context, stream);
+                                   }));
+        }
+
+        /**
+         * @brief 热加载数据库：在调用线程中加载文件并构建新快照，完成后原子替换当前快照。
+         * 正在执行的请求继续使用旧快照直到结束，新请求使用新快照；尚未合并的在线修改一并丢弃。
+         * 替换成功后清空 ListFeatures 结果缓存
+         * 
+         * @param db_path 数据库文件路径
+         * @return bool 是否替换成功，新数据库为空或加载失败时保留当前快照
          */
-        explicit RouteGuideImpl(const std::string &db)
+        bool Reload(const std::string &db_path)
         {
-            routeguide::ParseDb(db, &feature_list_);
+            if (!db_.Reload(db_path))
+            {
+                return false;
+            }
+            list_cache_.Clear();
+            return true;
         }
 
         /**
@@ -67,16 +133,17 @@ namespace routeguide
                           Feature *feature) override;
 
         /**
-         * @brief 列出 rectangle 矩形区域内的所有特性集合（服务端流RPC）
+         * @brief 列出 rectangle 矩形区域内的所有特性集合（服务端流RPC）。
+         * 主库中的 feature 直接发送加载时预编码的二进制数据，只有增量层中的记录需要现场序列化。
+         * 查询结果按 (矩形, 快照版本, 主库版本) 缓存，命中时跳过 R-tree 查询和增量层扫描。
+         * 命中行数较多时分发到各空间分区并行查询，哪个分区先完成就先发送哪个分区的结果
          * 
          * @param context gRPC的上下文
-         * @param rectangle 表示一个特定的矩形区域
-         * @param writer 返回流， Feature 数据集合
+         * @param stream 拆分流，先读取一个 Rectangle 请求，再返回 Feature 编码数据集合
          * @return Status gRPC调用返回结果
          */
-        Status ListFeatures(ServerContext *context,
-                            const routeguide::Rectangle *rectangle,
-                            ServerWriter<Feature> *writer) override;
+        Status ListFeaturesEncoded(ServerContext *context,
+                                   grpc::ServerSplitStreamer<Rectangle, grpc::ByteBuffer> *stream);
         
         /**
          * @brief 统计给定的地理位置集合 reader 中有多少个 Point ，多少个 Feature，位置之间总距离是多少（客户端流RPC）
@@ -99,8 +166,211 @@ namespace routeguide
         Status RouteChat(ServerContext *context,
                          ServerReaderWriter<RouteNote, RouteNote> *stream) override;
 
+        /**
+         * @brief 查找距离 request 中位置最近的 k 个 feature，按大圆距离从近到远返回（服务端流RPC）
+         * 
+         * @param context gRPC的上下文
+         * @param request 查询位置、返回个数 k 以及最大距离
+         * @param writer 返回流， Feature 数据集合
+         * @return Status gRPC调用返回结果
+         */
+        Status NearestFeatures(ServerContext *context, const NearestRequest *request,
+                               ServerWriter<Feature> *writer) override;
+
+        /**
+         * @brief 列出距离 request 中位置不超过 radius_m 米的所有 feature（服务端流RPC）
+         * 
+         * @param context gRPC的上下文
+         * @param request 圆心位置以及半径
+         * @param writer 返回流， Feature 数据集合
+         * @return Status gRPC调用返回结果
+         */
+        Status FeaturesWithinRadius(ServerContext *context, const RadiusRequest *request,
+                                    ServerWriter<Feature> *writer) override;
+
+        /**
+         * @brief 批量获取多个 point 位置的 feature 属性，一次往返完成所有查找（一元RPC）
+         * 
+         * @param context gRPC的上下文
+         * @param points 需要查找的地理位置集合
+         * @param features 与 points 一一对应的 feature 集合，没有 feature 的位置名称为空
+         * @return Status gRPC调用返回结果
+         */
+        Status GetFeatures(ServerContext *context, const PointBatch *points,
+                           FeatureBatch *features) override;
+
+        /**
+         * @brief 在一个调用上持续查找 point 位置的 feature 属性（双向流RPC）。
+         * 当前线程负责读取和查找，结果交给写线程发送，读取下一个 point 时无需等待上一个结果写完
+         * 
+         * @param context gRPC的上下文
+         * @param stream 双向流，每收到一个 point 按顺序返回一个 feature
+         * @return Status gRPC调用返回结果
+         */
+        Status LookupStream(ServerContext *context,
+                            ServerReaderWriter<Feature, Point> *stream) override;
+
+        /**
+         * @brief 新增或修改某个位置的 feature（一元RPC），修改写入增量层，对之后开始的请求立即可见
+         * 
+         * @param context gRPC的上下文
+         * @param feature 位置以及新的名称，名称不能为空
+         * @param result 修改序号以及修改前该位置是否已有 feature
+         * @return Status gRPC调用返回结果
+         */
+        Status UpsertFeature(ServerContext *context, const Feature *feature,
+                             MutationResult *result) override;
+
+        /**
+         * @brief 删除某个位置的 feature（一元RPC）
+         * 
+         * @param context gRPC的上下文
+         * @param point 需要删除的位置
+         * @param result 修改序号以及删除前该位置是否有 feature
+         * @return Status gRPC调用返回结果
+         */
+        Status DeleteFeature(ServerContext *context, const Point *point,
+                             MutationResult *result) override;
+
+        /**
+         * @brief 获取当前数据库快照的统计信息（一元RPC）
+         * 
+         * @param context gRPC的上下文
+         * @param request 保留，暂无参数
+         * @param stats 快照版本、feature 个数、未合并的修改条数、布隆过滤器的内存占用和误判率以及结果缓存的命中统计
+         * @return Status gRPC调用返回结果
+         */
+        Status GetServerStats(ServerContext *context, const StatsRequest *request,
+                              ServerStats *stats) override;
+
+        /**
+         * @brief 统计 rectangle 矩形区域内的 feature 个数（一元RPC）。
+         * 使用 R 树节点覆盖的条目范围计数，不逐个访问 feature，再按增量层中的记录修正
+         * 
+         * @param context gRPC的上下文
+         * @param rectangle 查询矩形
+         * @param count 矩形区域内的 feature 个数
+         * @return Status gRPC调用返回结果
+         */
+        Status CountFeatures(ServerContext *context, const Rectangle *rectangle,
+                             Count *count) override;
+
+        /**
+         * @brief 统计矩形区域内 cols x rows 网格中每个格子的 feature 个数（一元RPC）。
+         * 主库部分由多个线程并行扫描经纬度列完成，再按增量层中的记录修正
+         * 
+         * @param context gRPC的上下文
+         * @param request 查询矩形以及网格的列数和行数
+         * @param grid 按行优先排列的格子计数，第 0 行在最北端
+         * @return Status gRPC调用返回结果
+         */
+        Status FeatureDensity(ServerContext *context, const DensityRequest *request,
+                              DensityGrid *grid) override;
+
+        /**
+         * @brief 列出 polygon 多边形区域内的所有 feature（服务端流RPC）。
+         * 先用多边形的包围盒在 R 树中筛选候选，再用按纬度分带的边索引批量判断是否在多边形内
+         * 
+         * @param context gRPC的上下文
+         * @param polygon 多边形顶点，至少 3 个
+         * @param writer 返回流， Feature 数据集合
+         * @return Status gRPC调用返回结果
+         */
+        Status ListFeaturesInPolygon(ServerContext *context, const Polygon *polygon,
+                                     ServerWriter<Feature> *writer) override;
+
+        /**
+         * @brief 列出距离路线不超过 distance_m 米的所有 feature（双向流RPC）。
+         * 每收到一个路线点，就把它与上一个点组成的线段切分为若干包围盒在 R 树中查询，
+         * 再按到线段的大圆距离精确判断；相邻线段的查询区域重叠，已返回的 feature 不再重复返回
+         * 
+         * @param context gRPC的上下文
+         * @param stream 双向流，输入路线点，输出 Feature 数据集合
+         * @return Status gRPC调用返回结果
+         */
+        Status FeaturesAlongRoute(ServerContext *context,
+                                  ServerReaderWriter<Feature, CorridorPoint> *stream) override;
+
+        /**
+         * @brief 按名称检索 feature（一元RPC），不区分 ASCII 大小写。
+         * 先用前缀索引查找名称以查询串开头的 feature，不足 limit 个时再用三元组倒排索引查找名称包含查询串的 feature
+         * 
+         * @param context gRPC的上下文
+         * @param request 查询串以及最多返回的个数
+         * @param features 前缀匹配的结果按名称排序在前，子串匹配的结果在后
+         * @return Status gRPC调用返回结果
+         */
+        Status SearchFeatures(ServerContext *context, const SearchRequest *request,
+                              FeatureBatch *features) override;
+
+        /**
+         * @brief 列出位于 geohash 前缀所表示格子内的所有 feature（服务端流RPC）。
+         * 主库按 geohash 键排序，格子内的 feature 是二分查找得到的一段连续的行
+         * 
+         * @param context gRPC的上下文
+         * @param request geohash 前缀，1 到 12 个字符
+         * @param writer 返回流， Feature 数据集合，主库中的 feature 按 geohash 排序
+         * @return Status gRPC调用返回结果
+         */
+        Status ListFeaturesByGeohash(ServerContext *context, const GeohashRequest *request,
+                                     ServerWriter<Feature> *writer) override;
+
     private:
-        std::vector<Feature> feature_list_;
+        // ListFeatures 在 route_guide.proto 服务定义中的下标（从 0 开始）
+        static const int kListFeaturesMethodIndex = 1;
+
+        // ListFeatures 命中行数低于该值时不并行，分发和合并的开销超过并行带来的收益
+        static const size_t kMinScatterRows = 1 << 15;
+
+        // FeatureDensity 允许的最大格子数，每个扫描线程都要分配一份同样大小的计数数组
+        static const uint32_t kMaxDensityCells = 1 << 18;
+
+        // ListFeaturesInPolygon 允许的最大顶点数
+        static const int kMaxPolygonVertices = 1 << 20;
+
+        // SearchFeatures 未指定 limit 时的默认值以及允许的最大值
+        static const int kDefaultSearchLimit = 10;
+        static const int kMaxSearchLimit = 1000;
+
+        /**
+         * @brief ListFeatures 结果缓存的键。合并增量层不改变快照版本，但会重建主库、改变行号，因此同时带上主库版本
+         *
+         */
+        struct ListCacheKey
+        {
+            BoundingBox box; // 已归一化，min 不大于 max
+            uint64_t snapshot_version;
+            uint64_t base_version;
+
+            bool operator==(const ListCacheKey &other) const
+            {
+                return box.min_lat == other.box.min_lat && box.max_lat == other.box.max_lat &&
+                       box.min_lon == other.box.min_lon && box.max_lon == other.box.max_lon &&
+                       snapshot_version == other.snapshot_version && base_version == other.base_version;
+            }
+        };
+
+        struct ListCacheKeyHash
+        {
+            size_t operator()(const ListCacheKey &key) const;
+        };
+
+        /**
+         * @brief ListFeatures 的查询结果：主库中可见的行号，以及增量层中落在矩形内的记录的编码数据
+         *
+         */
+        struct ListCacheValue
+        {
+            std::vector<uint32_t> rows;
+            std::vector<std::string> delta_features;
+        };
+
+        typedef ShardedLruCache<ListCacheKey, std::shared_ptr<const ListCacheValue>, ListCacheKeyHash> ListCache;
+
+        LiveFeatureDb db_; // 主库 + 增量层，每个请求开始时取一次当前视图
+        ListCache list_cache_; // 按 feature 行数计算容量
+        ScatterOptions scatter_;
+        std::unique_ptr<ThreadPool> scatter_pool_; // 不并行时为空
         std::mutex mu_;
         std::vector<RouteNote> received_notes_;
     };
@@ -0,0 +1,73 @@
+// 只读文件内存映射
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace routeguide
+{
+    bool MappedFile::Open(const std::string &path, Access access)
+    {
+        Close();
+
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            int err = errno;
+            close(fd);
+            errno = err;
+            return false;
+        }
+        if (!S_ISREG(st.st_mode))
+        {
+            close(fd);
+            errno = EINVAL;
+            return false;
+        }
+        if (st.st_size == 0)
+        {
+            close(fd);
+            data_ = "";
+            return true;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int err = errno;
+        close(fd); // 映射建立后不再需要文件描述符
+        if (addr == MAP_FAILED)
+        {
+            errno = err;
+            return false;
+        }
+        // 顺序扫描时加大预读，已读过的页可以尽早回收
+        madvise(addr, size, access == kSequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+
+        data_ = static_cast<const char *>(addr);
+        size_ = size;
+        mapped_ = true;
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mapped_)
+        {
+            munmap(const_cast<char *>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+    }
+
+} // namespace routeguide
@@ -0,0 +1,64 @@
+/**
+ * @file mapped_file.h
+ * @author pj-x86 (pj81102@163.com)
+ * @brief 只读文件内存映射，用于直接在页缓存上解析大文件，避免把整个文件复制到堆上
+ * @version 0.1
+ * @date 2020-08-05
+ *
+ */
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace routeguide
+{
+    /**
+     * @brief 以只读方式映射整个文件，并按访问方式提示内核预读策略。
+     * 映射在 Close() 或析构时释放，释放后 data() 返回的指针失效。
+     * 空文件不建立映射，data() 返回指向空串的指针，size() 为 0
+     *
+     */
+    class MappedFile
+    {
+    public:
+        enum Access
+        {
+            kSequential, // 从前向后扫描一遍，如解析文本数据库(MADV_SEQUENTIAL)
+            kNormal,     // 按需访问，如直接在映射上查询快照中的索引，使用内核默认的预读(MADV_NORMAL)
+        };
+
+        MappedFile() : data_(nullptr), size_(0), mapped_(false) {}
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * @brief 映射 path 指定的文件，之前的映射会先被释放
+         *
+         * @param access 访问方式
+         * @return bool 是否成功，失败时 errno 保存失败原因；管道等不能映射的文件返回 false
+         */
+        bool Open(const std::string &path, Access access = kSequential);
+
+        /**
+         * @brief 释放映射，可重复调用
+         *
+         */
+        void Close();
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char *data_;
+        size_t size_;
+        bool mapped_; // 空文件没有建立映射，不需要 munmap
+    };
+
+} // namespace routeguide
+
+#endif //_MAPPED_FILE_H_